@@ -2,15 +2,28 @@
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
 
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/filesystem.hpp>
+
+#include <tbb/tbb.h>
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 #include <CCTag.hpp>
 #include <ICCTag.hpp>
+#include <Detection.hpp>
+#include <DetectionSession.hpp>
 
 // ++++++++++++++ ADAPTATION CODE FOR pycctag +++++++++++++++++++++++++++++++++++++++++++++
 
@@ -27,26 +40,81 @@ struct marker_st
 
 };
 
+PYBIND11_MAKE_OPAQUE(std::vector<marker_st>);
 
-auto detect_from_img(const cv::Mat graySrc)
+/**
+ * @brief One marker as a record of the numpy structured array returned with as_array=True.
+ * a, b and angle describe the outer ellipse in the input image.
+ */
+struct marker_record
 {
-    int err = 0;
-    return err;
-}
+    float x, y;
+    int id, status;
+    float quality;
+    float a, b, angle;
+    int pyramid_level;
+};
 
-auto detect_from_file(const std::string image_filename)
+std::vector<marker_st> to_marker_list(const cctag::CCTag::List& markers)
 {
-    
     std::vector<marker_st> marker_list;
+    marker_list.reserve(markers.size());
 
-    // load the image e.g. from file
-    cv::Mat src = cv::imread(image_filename);
-    cv::Mat graySrc;
-    cv::cvtColor(src, graySrc, cv::COLOR_BGR2GRAY);
+    for (const auto& marker : markers)
+    {
+        marker_st tmp_st;
+
+        tmp_st.status = marker.getStatus();
+        tmp_st.x = marker.x();
+        tmp_st.y = marker.y();
+        tmp_st.id = marker.id();
+
+        marker_list.push_back(tmp_st);
+    }
+
+    return marker_list;
+}
+
+/**
+ * @brief Fill a numpy structured array in one pass over the markers.
+ */
+pybind11::array_t<marker_record> to_marker_array(const cctag::CCTag::List& markers)
+{
+    pybind11::array_t<marker_record> marker_array(static_cast<pybind11::ssize_t>(markers.size()));
+    marker_record* record = marker_array.mutable_data();
+
+    for (const auto& marker : markers)
+    {
+        const auto& ellipse = marker.rescaledOuterEllipse();
 
+        record->x = marker.x();
+        record->y = marker.y();
+        record->id = marker.id();
+        record->status = marker.getStatus();
+        record->quality = marker.quality();
+        record->a = ellipse.a();
+        record->b = ellipse.b();
+        record->angle = ellipse.angle();
+        record->pyramid_level = marker.pyramidLevel();
+        ++record;
+    }
+
+    return marker_array;
+}
+
+pybind11::object to_result(const cctag::CCTag::List& markers, bool as_array)
+{
+    if (as_array)
+        return to_marker_array(markers);
+    return pybind11::cast(to_marker_list(markers));
+}
+
+pybind11::object detect_from_gray(const cv::Mat& graySrc, bool as_array)
+{
     // set up the parameters
     const std::size_t nCrowns{ 3 };
     cctag::Parameters params(nCrowns);
+    const cctag::CCTagMarkersBank bank(nCrowns);
 
     // choose a cuda pipe
     const int pipeId{ 0 };
@@ -55,32 +123,211 @@ auto detect_from_file(const std::string image_filename)
     const int frameId{ 0 };
 
     // process the image
-    boost::ptr_list<cctag::ICCTag> markers{};
-    
-    cctagDetection(markers, pipeId, frameId, graySrc, params);
-    
-    for (const auto& marker : markers)
+    cctag::CCTag::List markers;
+
     {
-        marker_st tmp_st;
-        
-        tmp_st.status = marker.getStatus();
-        tmp_st.x = marker.x();
-        tmp_st.y = marker.y();
-        tmp_st.id = marker.id();
+        // graySrc only references memory kept alive by the caller, python objects are not touched
+        pybind11::gil_scoped_release release;
+        cctag::cctagDetection(markers, pipeId, frameId, graySrc, params, bank, false);
+    }
 
-        marker_list.push_back(tmp_st);
+    return to_result(markers, as_array);
+}
+
+/**
+ * @brief Wrap a uint8 numpy array (HxW gray, HxWx1 gray or HxWx3 BGR) into a cv::Mat header.
+ * The pixels are shared with the numpy array whenever the layout allows it (positive row stride,
+ * packed pixels), otherwise they are copied. A BGR image always needs a conversion to gray.
+ */
+cv::Mat gray_from_array(const pybind11::array_t<std::uint8_t>& img)
+{
+    const pybind11::buffer_info info = img.request();
+
+    if (info.ndim != 2 && info.ndim != 3)
+        throw std::invalid_argument("detect_from_img: expected an array of shape (H, W) or (H, W, C)");
+
+    const int rows = static_cast<int>(info.shape[0]);
+    const int cols = static_cast<int>(info.shape[1]);
+    const int channels = info.ndim == 3 ? static_cast<int>(info.shape[2]) : 1;
+
+    if (channels != 1 && channels != 3)
+        throw std::invalid_argument("detect_from_img: expected 1 (gray) or 3 (BGR) channels");
+    if (rows == 0 || cols == 0)
+        throw std::invalid_argument("detect_from_img: empty image");
+
+    auto* data = static_cast<std::uint8_t*>(info.ptr);
+    const pybind11::ssize_t rowStride = info.strides[0];
+    const pybind11::ssize_t colStride = info.strides[1];
+    const pybind11::ssize_t chStride = info.ndim == 3 ? info.strides[2] : 1;
+
+    const bool packed = rowStride >= colStride * cols && colStride == channels && chStride == 1;
+    const int type = channels == 1 ? CV_8UC1 : CV_8UC3;
+
+    cv::Mat src;
+    if (packed)
+    {
+        // no copy: the header points into the numpy buffer
+        src = cv::Mat(rows, cols, type, data, static_cast<std::size_t>(rowStride));
+    }
+    else
+    {
+        // arbitrary (e.g. transposed or negative) strides cannot be expressed by cv::Mat
+        src.create(rows, cols, type);
+        for (int y = 0; y < rows; ++y)
+        {
+            std::uint8_t* dst = src.ptr<std::uint8_t>(y);
+            for (int x = 0; x < cols; ++x)
+                for (int c = 0; c < channels; ++c)
+                    *dst++ = data[y * rowStride + x * colStride + c * chStride];
+        }
     }
 
-    return marker_list;
+    if (channels == 1)
+        return src;
+
+    cv::Mat graySrc;
+    cv::cvtColor(src, graySrc, cv::COLOR_BGR2GRAY);
+    return graySrc;
 }
 
-// ++++++++++++++ START BINDING CODE pycctag +++++++++++++++++++++++++++++++++++++++++++++
-PYBIND11_MAKE_OPAQUE(std::vector<marker_st>);
+auto detect_from_img(const pybind11::array_t<std::uint8_t>& img, bool as_array)
+{
+    return detect_from_gray(gray_from_array(img), as_array);
+}
+
+cv::Mat gray_from_file(const std::string& image_filename)
+{
+    // load the image e.g. from file
+    cv::Mat src = cv::imread(image_filename);
+    if (src.empty())
+        throw std::invalid_argument("detect_from_file: cannot read the image " + image_filename);
+
+    cv::Mat graySrc;
+    cv::cvtColor(src, graySrc, cv::COLOR_BGR2GRAY);
+    return graySrc;
+}
+
+auto detect_from_file(const std::string image_filename, bool as_array)
+{
+    return detect_from_gray(gray_from_file(image_filename), as_array);
+}
+
+/**
+ * @brief Detect the markers of several frames concurrently on the TBB pool, with the GIL released.
+ * The result holds one marker list per input frame, in the input order.
+ */
+pybind11::list detect_batch(const std::vector<pybind11::array_t<std::uint8_t>>& images,
+                            std::size_t nCrowns,
+                            bool as_array)
+{
+    // the numpy buffers are only accessible with the GIL held: wrap them all first
+    std::vector<cv::Mat> graySrcs;
+    graySrcs.reserve(images.size());
+    for (const auto& img : images)
+        graySrcs.push_back(gray_from_array(img));
+
+    cctag::Parameters params(nCrowns);
+    // a CUDA pipe cannot be shared by concurrent detections
+    params.setUseCuda(false);
+    const cctag::CCTagMarkersBank bank(params._nCrowns);
+
+    std::vector<cctag::CCTag::List> markers(graySrcs.size());
+    {
+        pybind11::gil_scoped_release release;
+
+        // one session per worker thread, reused by all the frames it processes
+        tbb::enumerable_thread_specific<cctag::DetectionSession> sessions;
+
+        tbb::parallel_for(std::size_t(0), graySrcs.size(), [&](std::size_t i) {
+            // isolation keeps a thread waiting in the nested loops of this frame from picking up
+            // another frame, which would reset the session it is still using
+            tbb::this_task_arena::isolate([&] {
+                const int pipeId{ 0 };
+                cctag::cctagDetection(markers[i], pipeId, i, graySrcs[i], params, bank, false, nullptr, &sessions.local());
+            });
+        });
+    }
+
+    pybind11::list results;
+    for (const auto& frameMarkers : markers)
+        results.append(to_result(frameMarkers, as_array));
 
+    return results;
+}
+
+/**
+ * @brief Detector keeping the parameters, the marker bank and the detection buffers alive
+ * between frames, so that only the first frame (and any change of resolution) pays for
+ * their construction. Calls on the same detector are serialized.
+ */
+class Detector
+{
+public:
+    Detector(std::size_t nCrowns, const std::string& params_file, const std::string& bank_file)
+        : _params(load_parameters(nCrowns, params_file))
+        , _bank(bank_file.empty() ? cctag::CCTagMarkersBank(_params._nCrowns) : cctag::CCTagMarkersBank(bank_file))
+    {
+    }
+
+    pybind11::object detect(const pybind11::array_t<std::uint8_t>& img, bool as_array)
+    {
+        return detect_gray(gray_from_array(img), as_array);
+    }
+
+    pybind11::object detect_from_file(const std::string& image_filename, bool as_array)
+    {
+        return detect_gray(gray_from_file(image_filename), as_array);
+    }
+
+    std::size_t nCrowns() const { return _params._nCrowns; }
+
+private:
+    static cctag::Parameters load_parameters(std::size_t nCrowns, const std::string& params_file)
+    {
+        cctag::Parameters params(nCrowns);
+
+        if (!params_file.empty())
+        {
+            if (!boost::filesystem::exists(params_file))
+                throw std::invalid_argument("Detector: the parameter file \"" + params_file + "\" is missing");
+
+            std::ifstream ifs(params_file.c_str());
+            boost::archive::xml_iarchive ia(ifs);
+            ia >> boost::serialization::make_nvp("CCTagsParams", params);
+
+            if (params._nCrowns != nCrowns)
+                throw std::invalid_argument("Detector: nCrowns does not match the parameter file");
+        }
+        return params;
+    }
+
+    pybind11::object detect_gray(const cv::Mat& graySrc, bool as_array)
+    {
+        cctag::CCTag::List markers;
+        {
+            pybind11::gil_scoped_release release;
+            std::lock_guard<std::mutex> lock(_mutex);
+
+            const int pipeId{ 0 };
+            cctag::cctagDetection(markers, pipeId, _frame++, graySrc, _params, _bank, false, nullptr, &_session);
+        }
+        return to_result(markers, as_array);
+    }
+
+    cctag::Parameters _params;
+    cctag::CCTagMarkersBank _bank;
+    cctag::DetectionSession _session;
+    std::size_t _frame{ 0 };
+    std::mutex _mutex;
+};
+
+// ++++++++++++++ START BINDING CODE pycctag +++++++++++++++++++++++++++++++++++++++++++++
 PYBIND11_MODULE(pycctag, m)
 {
     m.doc() = "CCTag python wrapper for core functions";
 
+    PYBIND11_NUMPY_DTYPE(marker_record, x, y, id, status, quality, a, b, angle, pyramid_level);
+
     pybind11::bind_vector<std::vector<marker_st>>(m, "MarkerVector");
     pybind11::class_<marker_st>(m, "Marker")
         .def(pybind11::init())
@@ -89,9 +336,22 @@ PYBIND11_MODULE(pycctag, m)
         .def_property_readonly("status", &marker_st::getStatus)
         .def_property_readonly("id", &marker_st::getID);
 
-    m.def("detect_from_file", &detect_from_file, "Function to detetct markers from image file");
-    m.def("detect_from_img", &detect_from_img, "Function to detetct markers from image matrix");
+    m.def("detect_from_file", &detect_from_file, pybind11::arg("image_filename"), pybind11::arg("as_array") = false,
+          "Function to detetct markers from image file");
+    m.def("detect_from_img", &detect_from_img, pybind11::arg("img"), pybind11::arg("as_array") = false,
+          "Function to detetct markers from a uint8 numpy array (HxW gray or HxWx3 BGR), without copy when possible");
+
+    m.def("detect_batch", &detect_batch, pybind11::arg("images"), pybind11::arg("nCrowns") = 3, pybind11::arg("as_array") = false,
+          "Function to detetct markers in a list of uint8 numpy arrays in parallel, returns one result per image");
+
+    pybind11::class_<Detector>(m, "Detector")
+        .def(pybind11::init<std::size_t, const std::string&, const std::string&>(),
+             pybind11::arg("nCrowns") = 3, pybind11::arg("params_file") = "", pybind11::arg("bank_file") = "")
+        .def_property_readonly("nCrowns", &Detector::nCrowns)
+        .def("detect", &Detector::detect, pybind11::arg("img"), pybind11::arg("as_array") = false,
+             "Detect markers in a uint8 numpy array, reusing the buffers of the previous frames")
+        .def("detect_from_file", &Detector::detect_from_file, pybind11::arg("image_filename"), pybind11::arg("as_array") = false,
+             "Detect markers in an image file, reusing the buffers of the previous frames");
 
-    
+}    
 
-}
\ No newline at end of file
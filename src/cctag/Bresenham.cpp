@@ -61,13 +61,13 @@ EdgePoint* gradientDirectionDescent(
     int x = p.x();
     int y = p.y();
     
-    CCTagFileDebug::instance().newVote(x,y,dx,dy);
+    CCTAG_VOTE_DEBUG_CALL(newVote(x,y,dx,dy));
 
     if( ady > adx )
     {
 
         updateXY(dy,dx,y,x,e,stpY,stpX);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
+        CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
         
         n = n+1;
 
@@ -81,7 +81,7 @@ EdgePoint* gradientDirectionDescent(
         }
 
         updateXY(dy,dx,y,x,e,stpY,stpX);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
+        CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
         n = n+1;
 
         if( x >= 0 && x < canny.shape()[0] &&
@@ -101,7 +101,7 @@ EdgePoint* gradientDirectionDescent(
         while( n <= nmax)
         {
             updateXY(dy,dx,y,x,e, stpY,stpX);
-            CCTagFileDebug::instance().addFieldLinePoint(x, y);
+            CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
             n = n+1;
 
             if( x >= 0 && x < canny.shape()[0] &&
@@ -138,7 +138,7 @@ EdgePoint* gradientDirectionDescent(
     else
     {
         updateXY(dx,dy,x,y,e,stpX,stpY);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
+        CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
         n = n+1;
 
         if ( dx*dx+dy*dy > thrGradient )
@@ -151,7 +151,7 @@ EdgePoint* gradientDirectionDescent(
         }
 
         updateXY(dx,dy,x,y,e,stpX,stpY);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
+        CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
         n = n+1;
 
         if( x >= 0 && x < canny.shape()[0] &&
@@ -171,7 +171,7 @@ EdgePoint* gradientDirectionDescent(
         while( n <= nmax)
         {
             updateXY(dx,dy,x,y,e,stpX,stpY);
-            CCTagFileDebug::instance().addFieldLinePoint(x, y);
+            CCTAG_VOTE_DEBUG_CALL(addFieldLinePoint(x, y));
             n = n+1;
 
             if( x >= 0 && x < canny.shape()[0] &&
@@ -11,6 +11,7 @@
 
 #include <boost/numeric/conversion/bounds.hpp>
 
+#include <memory>
 #include <cmath>
 #include <fstream>
 #include <vector>
@@ -75,6 +76,56 @@ void CCTagMarkersBank::read( const std::string & file )
     }
   }
   input.close();
+  std::atomic_store( &_profiles, std::shared_ptr<const Profiles>() );
+}
+
+CCTagMarkersBank::Profiles::Profiles(
+        const std::vector< std::vector<float> > & markers,
+        std::size_t nSamples,
+        float beginSig,
+        float endSig )
+  : _nMarkers( markers.size() )
+  , _nSamples( nSamples )
+  , _beginSig( beginSig )
+  , _endSig( endSig )
+  , _digits( markers.size() * nSamples )
+{
+  const float stepX = ( endSig - beginSig ) / ( nSamples - 1.f );
+
+  for( std::size_t idc = 0; idc < _nMarkers; ++idc )
+  {
+    float* digit = _digits.data() + idc * _nSamples;
+    float x = beginSig;
+    for( std::size_t i = 0; i < _nSamples; ++i )
+    {
+      // Count the circles the sample lies outside of.
+      std::ptrdiff_t ldum = 0;
+      for( float rr : markers[idc] )
+      {
+        if( 1.f / rr <= x )
+        {
+          ++ldum;
+        }
+      }
+      // set odd value to -1 and even value to 1
+      digit[i] = - ( ldum % 2 ) * 2 + 1;
+
+      x += stepX;
+    }
+  }
+}
+
+std::shared_ptr<const CCTagMarkersBank::Profiles> CCTagMarkersBank::getProfiles(
+        std::size_t nSamples, float beginSig, float endSig ) const
+{
+  std::shared_ptr<const Profiles> profiles = std::atomic_load( &_profiles );
+  if( !profiles || !profiles->matches( nSamples, beginSig, endSig ) )
+  {
+    // Concurrent callers may both build the table, the last one is kept.
+    profiles = std::make_shared<const Profiles>( _markers, nSamples, beginSig, endSig );
+    std::atomic_store( &_profiles, profiles );
+  }
+  return profiles;
 }
 
 std::size_t CCTagMarkersBank::identify( const std::vector<float> & marker ) const
@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,6 +27,41 @@ namespace cctag
 class CCTagMarkersBank
 {
 public:
+  /**
+   * @brief 1D profiles of all the markers of the bank, sampled the way the
+   * rectified image cuts are: nSamples regularly spaced values from beginSig
+   * to endSig along the unit radius, -1 on the black crowns and 1 on the white
+   * ones. The profiles are stored row by row in one contiguous buffer.
+   */
+  class Profiles
+  {
+  public:
+    Profiles( const std::vector< std::vector<float> > & markers,
+              std::size_t nSamples,
+              float beginSig,
+              float endSig );
+
+    bool matches( std::size_t nSamples, float beginSig, float endSig ) const
+    {
+      return _nSamples == nSamples && _beginSig == beginSig && _endSig == endSig;
+    }
+
+    /// Number of markers, i.e. of rows.
+    std::size_t size() const { return _nMarkers; }
+    std::size_t nSamples() const { return _nSamples; }
+
+    /// Row-major nMarkers x nSamples table of the profiles.
+    const float* data() const { return _digits.data(); }
+    const float* row( std::size_t iMarker ) const { return _digits.data() + iMarker * _nSamples; }
+
+  private:
+    std::size_t _nMarkers;
+    std::size_t _nSamples;
+    float _beginSig;
+    float _endSig;
+    std::vector<float> _digits;
+  };
+
   explicit CCTagMarkersBank( std::size_t nCrowns );
   explicit CCTagMarkersBank( const std::string & file );
   
@@ -38,6 +74,13 @@ public:
     return _markers;
   }
 
+  /**
+   * @brief Profiles of the bank for the given sampling of the image cuts.
+   * The last requested table is kept, so that all the cuts of all the markers,
+   * which share the same sampling, are read against a single table.
+   */
+  std::shared_ptr<const Profiles> getProfiles( std::size_t nSamples, float beginSig, float endSig ) const;
+
 private:
   template <typename Iterator>
   bool cctagLineParse( Iterator first, Iterator last, std::vector<float>& rr )
@@ -68,6 +111,8 @@ private:
   static const float idFourCrowns[128][7];
   
   std::vector< std::vector<float> > _markers;
+  /// Shared across the threads identifying markers, only accessed atomically.
+  mutable std::shared_ptr<const Profiles> _profiles;
 
 };
 
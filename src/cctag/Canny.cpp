@@ -21,6 +21,18 @@ void edgesPointsFromCanny(
   std::size_t width = edges.cols;
   std::size_t height = edges.rows;
   
+  // Measure the edge budget first, the collection is sized on it.
+  std::size_t nEdges = 0;
+  for( int y = 0 ; y < height ; ++y )
+  {
+    const uchar* row = edges.ptr<uchar>(y);
+    for( int x = 0 ; x < width ; ++x )
+    {
+      nEdges += ( row[x] == 255 );
+    }
+  }
+  edgeCollection.reserve( nEdges );
+  
   for( int y = 0 ; y < height ; ++y )
   {
     for( int x = 0 ; x < width ; ++x )
@@ -36,9 +36,11 @@
 #include <boost/timer/timer.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <algorithm>
 #include <cmath>
 #include <exception>
 #include <fstream>
+#include <iterator>
 #include <list>
 #include <memory>
 #include <mutex>
@@ -65,14 +67,11 @@ namespace { using CandidatePtr = std::unique_ptr<Candidate>; }
  */
 std::vector<cctag::TagPipe*> cudaPipelines;
 
-static void constructFlowComponentFromSeed(
+static CandidatePtr constructFlowComponentFromSeed(
         EdgePoint * seed,
         EdgePointCollection& edgeCollection,
-        std::vector<CandidatePtr> & vCandidateLoopOne,
         const Parameters & params)
 {
-  static std::mutex G_SortMutex;
-  
   assert( seed );
   // Check if the seed has already been processed, i.e. belongs to an already
   // reconstructed flow component.
@@ -101,26 +100,23 @@ static void constructFlowComponentFromSeed(
         ++nVotedPoints;
     }
     
-    {
-      std::lock_guard<std::mutex> lock(G_SortMutex);
-      candidate->_averageReceivedVote = (float) (nReceivedVote*nReceivedVote) / (float) nVotedPoints;
-      auto it = std::lower_bound(vCandidateLoopOne.begin(), vCandidateLoopOne.end(), candidate,
-        [](const CandidatePtr& c1, const CandidatePtr& c2) { return c1->_averageReceivedVote > c2->_averageReceivedVote; });
-      vCandidateLoopOne.insert(it, std::move(candidate));
-    }
+    candidate->_averageReceivedVote = (float) (nReceivedVote*nReceivedVote) / (float) nVotedPoints;
+    return candidate;
   }
+  return nullptr;
 }
 
-static void completeFlowComponent(
+/* Brief: Recover the outer ellipse of a flow component from its convex edge segment.
+ * Returns whether the candidate is kept for the flow component assembling.
+ */
+static bool completeFlowComponent(
   Candidate & candidate,
   const EdgePointCollection& edgeCollection,
-  std::vector<Candidate> & vCandidateLoopTwo,
   std::size_t& nSegmentOut,
-  std::size_t runId,
+  EdgePointVisits& visited,
   const Parameters & params)
 {
   static std::mutex G_UpdateMutex;
-  static std::mutex G_InsertMutex;
   
   try
   {
@@ -130,7 +126,7 @@ static void completeFlowComponent(
 
     if (children.size() < params._minPointsSegmentCandidate)
     {
-      return;
+      return false;
     }
 
     candidate._score = children.size();
@@ -150,7 +146,7 @@ static void completeFlowComponent(
     if (filteredChildren.size() < 5)
     {
       DO_TALK( CCTAG_COUT_DEBUG(" filteredChildren.size() < 5 "); )
-      return;
+      return false;
     }
 
     std::size_t nLabel = -1;
@@ -195,7 +191,7 @@ static void completeFlowComponent(
     goodInit = ellipseGrowingInit(filteredChildren, outerEllipse);
 
     ellipseGrowing2(edgeCollection, filteredChildren, outerEllipsePoints, outerEllipse,
-                    params._ellipseGrowingEllipticHullWidth, runId, goodInit);
+                    params._ellipseGrowingEllipticHullWidth, visited, goodInit);
 
     candidate._nLabel = nLabel;
 
@@ -221,31 +217,26 @@ static void completeFlowComponent(
     if (SmFinal > params._thrMedianDistanceEllipse)
     {
       DO_TALK( CCTAG_COUT_DEBUG("SmFinal < params._thrMedianDistanceEllipse -- after ellipseGrowing"); )
-      return;
+      return false;
     }
 
     float quality = (float) outerEllipsePoints.size() / (float) rasterizeEllipsePerimeter(outerEllipse);
     if (quality > 1.1)
     {
       DO_TALK( CCTAG_COUT_DEBUG("Quality too high!"); )
-      return;
+      return false;
     }
 
     float ratioSemiAxes = outerEllipse.a() / outerEllipse.b();
     if ((ratioSemiAxes < 0.05) || (ratioSemiAxes > 20))
     {
       DO_TALK( CCTAG_COUT_DEBUG("Too high semi-axis ratio!"); )
-      return;
-    }
-
-    {
-      std::lock_guard<std::mutex> lock(G_InsertMutex);
-      vCandidateLoopTwo.push_back(candidate);
+      return false;
     }
 
 #ifdef CCTAG_SERIALIZE
     // Add children to output the filtering results (from outlierRemoval)
-    vCandidateLoopTwo.back().setchildren(children);
+    candidate.setchildren(children);
 
     // Write all selectedFlowComponent
     CCTagFlowComponent flowComponent(edgeCollection, outerEllipsePoints, children, filteredChildren,
@@ -254,6 +245,7 @@ static void completeFlowComponent(
     CCTagFileDebug::instance().outputFlowComponentInfos(flowComponent);
 #endif
 
+    return true;
   }
   catch (cv::Exception& e)
   {
@@ -263,6 +255,7 @@ static void completeFlowComponent(
   {
     DO_TALK( CCTAG_COUT_DEBUG( "Exception raised in the second main loop." ); )
   }
+  return false;
 }
 
 /* Brief: Aims to assemble two flow components if they lie on the same image CCTag
@@ -375,8 +368,9 @@ static void flowComponentAssembling(
   const float spendTime = d.total_milliseconds();
 }
 
-static void cctagDetectionFromEdgesLoopTwoIteration(
-  CCTag::List& markers,
+/* Brief: Build the marker of a flow component, if it passes all the tests.
+ */
+static std::unique_ptr<CCTag> cctagDetectionFromEdgesLoopTwoIteration(
   EdgePointCollection& edgeCollection,
   const std::vector<Candidate>& vCandidateLoopTwo,
   size_t iCandidate,
@@ -384,8 +378,6 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
   float scale,
   const Parameters& params)
 {
-    static std::mutex G_InsertMutex;
-    
     const Candidate& candidate = vCandidateLoopTwo[iCandidate];
 
 #ifdef CCTAG_SERIALIZE
@@ -432,7 +424,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
         DO_TALK( CCTAG_COUT_DEBUG("Points outside the outer ellipse OR CCTag not valid : bad gradient orientations"); )
         CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(PTSOUTSIDE_OR_BADGRADORIENT);
         CCTagFileDebug::instance().incrementFlowComponentIndex(0);
-        return;
+        return nullptr;
       }
       else
       {
@@ -457,7 +449,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
                ( realSizeOuterEllipsePoints < 50.0  ) )
       {
               DO_TALK( CCTAG_COUT_DEBUG( "Not enough outer ellipse points: realSizeOuterEllipsePoints : " << realSizeOuterEllipsePoints << ", rasterizeEllipsePerimeter : " << rasterizeEllipsePerimeter( outerEllipse )*scale << ", quality : " << quality ); )
-              return;
+              return nullptr;
       }
 
       cctag::Point2d<Eigen::Vector3f> markerCenter;
@@ -470,7 +462,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
         CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(RATIO_SEMIAXIS);
         CCTagFileDebug::instance().incrementFlowComponentIndex(0);
         DO_TALK( CCTAG_COUT_DEBUG("Too high ratio between semi-axes!"); )
-        return;
+        return nullptr;
       }
 
       // TODO@stian: remove allocation from loop iteration
@@ -515,7 +507,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
         CCTagFileDebug::instance().incrementFlowComponentIndex(0);
 
         DO_TALK( CCTAG_COUT_DEBUG("Distance max to high!"); )
-        return;
+        return nullptr;
       }
 
       float quality2 = 0;
@@ -528,22 +520,18 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
       
       quality2 *= scale;
 
-      CCTag* tag = new CCTag( -1,
+      std::unique_ptr<CCTag> tag( new CCTag( -1,
                               outerEllipse.center(),
                               cctagPoints,
                               outerEllipse,
                               markerHomography,
                               pyramidLevel,
                               scale,
-                              quality2 );
+                              quality2 ) );
 #ifdef CCTAG_SERIALIZE
       tag->setFlowComponents( componentCandidates, edgeCollection);
 #endif
       
-      {
-        std::lock_guard<std::mutex> lock(G_InsertMutex);
-        markers.push_back( tag ); // markers takes responsibility for delete
-      }
 #ifdef CCTAG_SERIALIZE
 #ifdef DEBUG
 
@@ -553,6 +541,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
 #endif
 
       DO_TALK( CCTAG_COUT_DEBUG("------------------------------Added marker------------------------------"); )
+      return tag;
     }
     catch (...)
     {
@@ -562,6 +551,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
       //CCTAG_COUT_CURRENT_EXCEPTION;
       DO_TALK( CCTAG_COUT_DEBUG( "Exception raised" ); )
     }
+    return nullptr;
 }
 
 void cctagDetectionFromEdges(
@@ -601,9 +591,13 @@ void cctagDetectionFromEdges(
 
   const std::size_t nMaximumNbSeeds = std::max(src.rows/2, (int) params._maximumNbSeeds);
   
-  const std::size_t nSeedsToProcess = std::min(seeds.size(), nMaximumNbSeeds);
+  // Rank the seeds based on the number of received votes, only the processed ones are sorted.
+  const std::vector<EdgePoint*> rankedSeeds = selectSeeds(seeds, nMaximumNbSeeds);
+  const std::size_t nSeedsToProcess = rankedSeeds.size();
 
-  std::vector<CandidatePtr> vCandidateLoopOne;
+  // Flow components built by every thread, with the rank of their seed
+  using RankedCandidates = std::vector<std::pair<std::size_t, CandidatePtr>>;
+  tbb::enumerable_thread_specific<RankedCandidates> candidatesLoopOne;
 
   // Process all the first-nSeedsToProcess seeds.
   // In the following loop, a seed will lead to a flow component if it lies
@@ -612,24 +606,51 @@ void cctagDetectionFromEdges(
   // will be collected and constitute the initial data of a flow component.
   
 #ifndef CCTAG_SERIALIZE
-  tbb::parallel_for(size_t(0), nSeedsToProcess, [&](int iSeed) {
+  tbb::parallel_for(size_t(0), nSeedsToProcess, [&](size_t iSeed) {
 #else 
   for(size_t iSeed=0 ; iSeed < nSeedsToProcess; ++iSeed)
   {
 #endif
-    assert( seeds[iSeed] );
-    constructFlowComponentFromSeed(seeds[iSeed], edgeCollection, vCandidateLoopOne, params);
+    assert( rankedSeeds[iSeed] );
+    CandidatePtr candidate = constructFlowComponentFromSeed(rankedSeeds[iSeed], edgeCollection, params);
+    if( candidate )
+      candidatesLoopOne.local().emplace_back(iSeed, std::move(candidate));
 #ifndef CCTAG_SERIALIZE
   });
 #else
   }
 #endif
 
+  // Sort the flow components by decreasing average number of received votes, the ones
+  // with equal averages from the last seed to the first one, as inserting them one after
+  // the other in seed order used to.
+  RankedCandidates rankedCandidates;
+  for(RankedCandidates& candidates : candidatesLoopOne)
+  {
+    std::move(candidates.begin(), candidates.end(), std::back_inserter(rankedCandidates));
+  }
+  std::sort(rankedCandidates.begin(), rankedCandidates.end(),
+    [](const RankedCandidates::value_type& c1, const RankedCandidates::value_type& c2) {
+      if( c1.second->_averageReceivedVote != c2.second->_averageReceivedVote )
+        return c1.second->_averageReceivedVote > c2.second->_averageReceivedVote;
+      return c1.first > c2.first;
+    });
+
+  std::vector<CandidatePtr> vCandidateLoopOne;
+  vCandidateLoopOne.reserve(rankedCandidates.size());
+  for(auto& candidate : rankedCandidates)
+  {
+    vCandidateLoopOne.push_back(std::move(candidate.second));
+  }
+
   const std::size_t nFlowComponentToProcessLoopTwo = 
           std::min(vCandidateLoopOne.size(), params._maximumNbCandidatesLoopTwo);
 
-  std::vector<Candidate> vCandidateLoopTwo;
-  vCandidateLoopTwo.reserve(nFlowComponentToProcessLoopTwo);
+  // Whether every flow component of the first loop is kept, one byte each to avoid
+  // sharing bits between threads.
+  std::vector<char> completedLoopOne(nFlowComponentToProcessLoopTwo, 0);
+  // Edge points reached by the ellipse growing, one set per thread
+  tbb::enumerable_thread_specific<EdgePointVisits> visits;
 
   // Second main loop:
   // From the flow components selected in the first loop, the outer ellipse will
@@ -645,13 +666,21 @@ void cctagDetectionFromEdges(
     for(size_t iCandidate=0 ; iCandidate < nFlowComponentToProcessLoopTwo; ++iCandidate)
     {
 #endif
-      size_t runId = iCandidate;
-      completeFlowComponent(*vCandidateLoopOne[iCandidate], edgeCollection, vCandidateLoopTwo, nSegmentOut, runId, params);
+      completedLoopOne[iCandidate] = completeFlowComponent(*vCandidateLoopOne[iCandidate], edgeCollection, nSegmentOut, visits.local(), params);
 #ifndef CCTAG_SERIALIZE  
     });
 #else
   }
 #endif
+
+  // The kept flow components, in the order of the first loop
+  std::vector<Candidate> vCandidateLoopTwo;
+  vCandidateLoopTwo.reserve(std::count(completedLoopOne.begin(), completedLoopOne.end(), 1));
+  for(size_t iCandidate=0 ; iCandidate < nFlowComponentToProcessLoopTwo; ++iCandidate)
+  {
+    if( completedLoopOne[iCandidate] )
+      vCandidateLoopTwo.push_back(*vCandidateLoopOne[iCandidate]);
+  }
   
   DO_TALK(
     CCTAG_COUT_VAR_DEBUG(vCandidateLoopTwo.size());
@@ -675,16 +704,25 @@ void cctagDetectionFromEdges(
 
   const size_t candidateLoopTwoCount = vCandidateLoopTwo.size();
 
+  // One slot per flow component, the markers are appended in the flow component order.
+  std::vector<std::unique_ptr<CCTag>> loopTwoMarkers(candidateLoopTwoCount);
+
 #ifndef CCTAG_SERIALIZE
   tbb::parallel_for(size_t(0), candidateLoopTwoCount, [&](size_t iCandidate) {
 #else
   for(size_t iCandidate=0 ; iCandidate < vCandidateLoopTwo.size(); ++iCandidate)
 #endif
-    cctagDetectionFromEdgesLoopTwoIteration(markers, edgeCollection, vCandidateLoopTwo, iCandidate,
+    loopTwoMarkers[iCandidate] = cctagDetectionFromEdgesLoopTwoIteration(edgeCollection, vCandidateLoopTwo, iCandidate,
       pyramidLevel, scale, params);
 #ifndef CCTAG_SERIALIZE
   });
 #endif
+
+  for(std::unique_ptr<CCTag>& marker : loopTwoMarkers)
+  {
+    if( marker )
+      markers.push_back( marker.release() ); // markers takes responsibility for delete
+  }
   
   boost::posix_time::ptime tstop2(boost::posix_time::microsec_clock::local_time());
   boost::posix_time::time_duration d2 = tstop2 - tstop1;
@@ -768,6 +806,7 @@ cctag::TagPipe* initCuda( int      pipeId,
  * @param[in] providedParams Contains all the parameters.
  * @param[in] bank CCTag bank.
  * @param[in] No longer used.
+ * @param[in] session Optional buffers reused from one frame to the next.
  */
 void cctagDetection(
         CCTag::List& markers,
@@ -777,7 +816,8 @@ void cctagDetection(
         const Parameters & providedParams,
         const cctag::CCTagMarkersBank & bank,
         bool bDisplayEllipses,
-        cctag::logtime::Mgmt* durations )
+        cctag::logtime::Mgmt* durations,
+        DetectionSession* session )
 
 {
     using namespace cctag;
@@ -795,10 +835,14 @@ void cctagDetection(
     bool cuda_allocates = false;
 #endif
   
-    ImagePyramid imagePyramid( imgGraySrc.cols,
-                               imgGraySrc.rows,
-                               params._numberOfProcessedMultiresLayers,
-                               cuda_allocates );
+    // Without a caller-provided session the buffers only live for this frame.
+    DetectionSession localSession;
+    DetectionSession& detectionSession = session ? *session : localSession;
+
+    ImagePyramid& imagePyramid = detectionSession.imagePyramid( imgGraySrc.cols,
+                                                                imgGraySrc.rows,
+                                                                params._numberOfProcessedMultiresLayers,
+                                                                cuda_allocates );
 
     cctag::TagPipe* pipe1 = nullptr;
 #ifdef CCTAG_WITH_CUDA
@@ -846,6 +890,7 @@ void cctagDetection(
                             frame,
                             pipe1,
                             params,
+                            detectionSession,
                             durations );
 
     if( durations ) durations->log( "after cctagMultiresDetection" );
@@ -883,18 +928,33 @@ void cctagDetection(
 
         std::vector<std::vector<cctag::ImageCut> > vSelectedCuts( numTags );
 		std::vector<int> detected(numTags, -1);
-        int                          tagIndex = 0;
-
-        for( const CCTag& cctag : markers ) {
-            detected[tagIndex] = cctag::identification::identify_step_1(
-                tagIndex,
-                cctag,
-                vSelectedCuts[tagIndex],
-                imagePyramid.getLevel(0)->getSrc(),
+
+        // Markers are identified independently of each other; index them so
+        // that the identification steps can be spread over the markers.
+        std::vector<CCTag*> vMarkers;
+        vMarkers.reserve( numTags );
+        for( CCTag& cctag : markers ) {
+            vMarkers.push_back( &cctag );
+        }
+
+        const cv::Mat& src = imagePyramid.getLevel(0)->getSrc();
+
+        const auto identifyStep1 = [&]( std::size_t iTag ) {
+            detected[iTag] = cctag::identification::identify_step_1(
+                iTag,
+                *vMarkers[iTag],
+                vSelectedCuts[iTag],
+                src,
                 params );
+        };
 
-            tagIndex++;
+#ifndef CCTAG_SERIALIZE
+        tbb::parallel_for( std::size_t(0), numTags, identifyStep1 );
+#else
+        for( std::size_t iTag = 0; iTag < numTags; ++iTag ) {
+            identifyStep1( iTag );
         }
+#endif
 
         if( markers.size() != numTags ) {
             cerr << __FILE__ << ":" << __LINE__ << " Number of markers has changed in identify_step_1" << endl;
@@ -904,7 +964,7 @@ void cctagDetection(
         if( pipe1 && numTags > 0 ) {
             pipe1->uploadCuts( numTags, &vSelectedCuts[0], params );
 
-            tagIndex = 0;
+            int tagIndex = 0;
             int debug_num_calls = 0;
             for( CCTag& cctag : markers ) {
                 if( vSelectedCuts[tagIndex].size() <= 2 ) {
@@ -937,28 +997,33 @@ void cctagDetection(
         }
 #endif // CCTAG_WITH_CUDA
 
-        tagIndex = 0;
+        const auto identifyStep2 = [&]( std::size_t iTag ) {
+            CCTag & cctag = *vMarkers[iTag];
 
-        CCTag::List::iterator it = markers.begin();
-        while (it != markers.end())
-        {
-            CCTag & cctag = *it;
-
-            if( detected[tagIndex] == status::id_reliable ) {
-                detected[tagIndex] = cctag::identification::identify_step_2(
-                    tagIndex,
+            if( detected[iTag] == status::id_reliable ) {
+                detected[iTag] = cctag::identification::identify_step_2(
+                    iTag,
                     cctag,
-                    vSelectedCuts[tagIndex],
-                    bank.getMarkers(),
-                    imagePyramid.getLevel(0)->getSrc(),
+                    vSelectedCuts[iTag],
+                    bank,
+                    src,
                     pipe1,
                     params );
             }
 
-            cctag.setStatus( detected[tagIndex] );
-            ++it;
+            cctag.setStatus( detected[iTag] );
+        };
 
-            tagIndex++;
+#ifndef CCTAG_SERIALIZE
+        // The GPU pipe is fed one marker at a time, keep it on this thread.
+        if( !pipe1 ) {
+            tbb::parallel_for( std::size_t(0), numTags, identifyStep2 );
+        } else
+#endif
+        {
+            for( std::size_t iTag = 0; iTag < numTags; ++iTag ) {
+                identifyStep2( iTag );
+            }
         }
         if( durations ) durations->log( "after cctag::identification::identify" );
     }
@@ -972,18 +1037,7 @@ void cctagDetection(
 #endif
     
     // Delete overlapping markers while keeping the best ones.
-    CCTag::List markersPrelim, markersFinal;
-    for(const CCTag & marker : markers)
-    {
-        update(markersPrelim, marker);
-    }
-
-    for(const CCTag & marker : markersPrelim)
-    {
-      update(markersFinal, marker);
-    }
-
-    markers = markersFinal;
+    removeOverlappingMarkers(markers);
   
     markers.sort();
 
@@ -10,6 +10,7 @@
 
 #include <cctag/CCTag.hpp>
 #include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/DetectionSession.hpp>
 #include <cctag/Types.hpp>
 #include <cctag/Params.hpp>
 #include <cctag/utils/LogTime.hpp>
@@ -37,6 +38,7 @@ class EdgePointImage;
  * @param[in] bank CCTag bank.
  * @param[in] bDisplayEllipses Optional object to store execution times.
  * @param[in] durations No longer used.
+ * @param[in] session Optional buffers reused from one frame to the next. If null, they are allocated for this call only.
  */
 void cctagDetection(CCTag::List& markers,
                     int pipeId,
@@ -45,7 +47,8 @@ void cctagDetection(CCTag::List& markers,
                     const Parameters& providedParams,
                     const cctag::CCTagMarkersBank& bank,
                     bool bDisplayEllipses = true,
-                    logtime::Mgmt* durations = nullptr);
+                    logtime::Mgmt* durations = nullptr,
+                    DetectionSession* session = nullptr);
 
 void cctagDetectionFromEdges(CCTag::List& markers,
                              EdgePointCollection& edgeCollection,
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/DetectionSession.hpp>
+
+namespace cctag
+{
+
+EdgePointCollection& DetectionSession::edgeCollection(std::size_t level, std::size_t width, std::size_t height)
+{
+  if (_edgeCollections.size() <= level)
+    _edgeCollections.resize(level + 1);
+
+  std::unique_ptr<EdgePointCollection>& edgeCollection = _edgeCollections[level];
+  if (!edgeCollection)
+    edgeCollection.reset(new EdgePointCollection(width, height));
+  else
+    edgeCollection->reset(width, height);
+
+  return *edgeCollection;
+}
+
+ImagePyramid& DetectionSession::imagePyramid(std::size_t width, std::size_t height, std::size_t nLevels, bool cuda_allocates)
+{
+  if (!_imagePyramid ||
+      width != _pyramidWidth || height != _pyramidHeight ||
+      nLevels != _pyramidNLevels || cuda_allocates != _pyramidCudaAllocates)
+  {
+    // Release the old levels before allocating the new ones.
+    _imagePyramid.reset();
+    _imagePyramid.reset(new ImagePyramid(width, height, nLevels, cuda_allocates));
+    _pyramidWidth = width;
+    _pyramidHeight = height;
+    _pyramidNLevels = nLevels;
+    _pyramidCudaAllocates = cuda_allocates;
+  }
+  return *_imagePyramid;
+}
+
+} // namespace cctag
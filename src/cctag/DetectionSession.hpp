@@ -0,0 +1,61 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef VISION_CCTAG_DETECTION_SESSION_HPP_
+#define VISION_CCTAG_DETECTION_SESSION_HPP_
+
+#include <cctag/ImagePyramid.hpp>
+#include <cctag/Types.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cctag {
+
+/**
+ * @brief Buffers that survive between two calls to cctagDetection.
+ *
+ * Allocating the image pyramid and the per-level edge point collections is expensive, a
+ * session keeps them alive so that consecutive frames of the same resolution only have to
+ * reset them. A session must not be used by two detections at the same time.
+ */
+class DetectionSession
+{
+public:
+  DetectionSession() = default;
+
+  DetectionSession(const DetectionSession&) = delete;
+
+  DetectionSession& operator=(const DetectionSession&) = delete;
+
+  /**
+   * @brief Get the edge point collection used for a pyramid level, emptied and set up for a
+   * frame of size width x height.
+   */
+  EdgePointCollection& edgeCollection(std::size_t level, std::size_t width, std::size_t height);
+
+  /**
+   * @brief Get the image pyramid for a frame of size width x height. The pyramid of the
+   * previous frame is returned as is if it has the same size, number of levels and allocation
+   * mode, otherwise it is rebuilt.
+   */
+  ImagePyramid& imagePyramid(std::size_t width, std::size_t height, std::size_t nLevels, bool cuda_allocates);
+
+private:
+  std::vector<std::unique_ptr<EdgePointCollection>> _edgeCollections;
+
+  std::unique_ptr<ImagePyramid> _imagePyramid;
+  std::size_t _pyramidWidth = 0;
+  std::size_t _pyramidHeight = 0;
+  std::size_t _pyramidNLevels = 0;
+  bool _pyramidCudaAllocates = false;
+};
+
+} // namespace cctag
+
+#endif
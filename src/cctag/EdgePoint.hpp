@@ -33,7 +33,6 @@ public:
     , _grad( p._grad )
     , _normGrad ( p._normGrad )
     , _flowLength (0)
-    , _processed( 0 )
     , _isMax( -1 )
     , _nSegmentOut(-1)
   {}
@@ -43,7 +42,6 @@ public:
     , _grad(vdx, vdy)
     , _normGrad(std::sqrt( vdx * vdx + vdy * vdy ))
     , _flowLength (0)
-    , _processed( 0 )
     , _isMax( -1 )
     , _nSegmentOut(-1)
   {
@@ -76,14 +74,13 @@ private:
   float _normGrad;
 public:
   float _flowLength;
-  uint64_t _processed;   // bitfield; must be 64-bit
   int _isMax;
   int _nSegmentOut;     // std::size_t _nSegmentOut;
 };
 
 // Calculation: sizeof(Vector3s)==8 (3*2=6 + 2 bytes of padding to 8 bytes)
-// 4*sizeof(float) == 16; plus uint64_t + 2 ints
-static_assert(sizeof(EdgePoint) == 8+16+16, "EdgePoint not packed");
+// 4*sizeof(float) == 16; plus 2 ints
+static_assert(sizeof(EdgePoint) == 8+16+8, "EdgePoint not packed");
 
 inline bool receivedMoreVoteThan(const EdgePoint * const p1,  const EdgePoint * const p2)
 {
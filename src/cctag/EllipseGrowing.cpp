@@ -323,13 +323,12 @@ bool ellipseGrowingInit(const std::vector<EdgePoint*>& filteredChildren, numeric
   return goodInit;
 }
 
-void connectedPoint(std::vector<EdgePoint*>& pts, int runId,
+void connectedPoint(std::vector<EdgePoint*>& pts, EdgePointVisits& visited,
         const EdgePointCollection& img, numerical::geometry::Ellipse& qIn,
         numerical::geometry::Ellipse& qOut, int x, int y)
 {
   BOOST_ASSERT(img(x,y));
-  const size_t threadMask = (size_t)1 << runId;
-  img(x,y)->_processed |= threadMask;  // Set as processed
+  visited.insert(img(img(x,y)));  // Set as processed
 
   static int xoff[] = {1, 1, 0, -1, -1, -1, 0, 1};
   static int yoff[] = {0, -1, -1, -1, 0, 1, 1, 1};
@@ -345,7 +344,7 @@ void connectedPoint(std::vector<EdgePoint*>& pts, int runId,
 
       if (e && // If unprocessed
           isInHull(qIn, qOut, e) &&
-          !(e->_processed & threadMask))
+          !visited.test(img(e)))
       {
         Eigen::Vector2f gradE;
         gradE(0) = e->dX();
@@ -358,8 +357,8 @@ void connectedPoint(std::vector<EdgePoint*>& pts, int runId,
         if (gradE.dot(eO) < 0)
         {
           pts.push_back(e);
-          e->_processed |= threadMask;
-          connectedPoint(pts, runId, img, qIn, qOut, sx, sy);
+          visited.insert(img(e));
+          connectedPoint(pts, visited, img, qIn, qOut, sx, sy);
         }
       }
     }
@@ -386,7 +385,7 @@ void ellipseHull(const EdgePointCollection& img,
         std::vector<EdgePoint*>& pts,
         numerical::geometry::Ellipse& ellipse,
         float delta,
-        std::size_t runId)
+        EdgePointVisits& visited)
 {
   numerical::geometry::Ellipse qIn, qOut;
   computeHull(ellipse, delta, qIn, qOut);
@@ -396,7 +395,7 @@ void ellipseHull(const EdgePointCollection& img,
   for (std::size_t i = 0; i < initSize; ++i)
   {
     EdgePoint *e = pts[i];
-    connectedPoint(pts, runId, img, qIn, qOut, e->x(), e->y());
+    connectedPoint(pts, visited, img, qIn, qOut, e->x(), e->y());
   }
 }
 
@@ -406,16 +405,16 @@ void ellipseGrowing2(
         std::vector<EdgePoint*>& outerEllipsePoints,
         numerical::geometry::Ellipse& ellipse,
         float ellipseGrowingEllipticHullWidth,
-        std::size_t runId,
+        EdgePointVisits& visited,
         bool goodInit)
 {
-  const size_t threadMask = (size_t)1 << runId;
+  visited.clear(img.get_point_count());
   outerEllipsePoints.reserve(filteredChildren.size()*3);
 
   for(EdgePoint * children : filteredChildren)
   {
     outerEllipsePoints.push_back(children);
-    children->_processed |= threadMask;
+    visited.insert(img(children));
   }
 
   int lastSizePoints = 0;
@@ -446,7 +445,7 @@ void ellipseGrowing2(
         }
       }
 
-      ellipseHull(img, outerEllipsePoints, ellipse, ellipseGrowingEllipticHullWidth, runId);
+      ellipseHull(img, outerEllipsePoints, ellipse, ellipseGrowingEllipticHullWidth, visited);
       edgePointsSets.push_back(outerEllipsePoints);
       ellipsesSets.push_back(ellipse);
 
@@ -476,16 +475,12 @@ void ellipseGrowing2(
     ellipse = ellipsesSets[nIterMax];
     
     // Set all the processed edge points as not processed as only a subset of them
-    // correspond to outerEllipsePoints which must be finally set to runId.
-    for(auto & vedgePoint: edgePointsSets)
-    {
-      for(auto & point: vedgePoint)
-        point->_processed &= ~threadMask; // Could be any value different of runId
-    }
+    // correspond to outerEllipsePoints which must be finally set as processed.
+    visited.clear(img.get_point_count());
     // Set as processed all the outerEllipsePoints
     for(auto & point: outerEllipsePoints)
     {
-      point->_processed |= threadMask;
+      visited.insert(img(point));
     }
     
   }
@@ -499,7 +494,7 @@ void ellipseGrowing2(
   {
     lastSizePoints = outerEllipsePoints.size();
 
-    ellipseHull(img, outerEllipsePoints, ellipse, ellipseGrowingEllipticHullWidth, runId);
+    ellipseHull(img, outerEllipsePoints, ellipse, ellipseGrowingEllipticHullWidth, visited);
     // Compute the new ellipse which fits oulierEllipsePoints
     numerical::ellipseFitting(ellipse, outerEllipsePoints);
 
@@ -13,7 +13,9 @@
 #include <cctag/geometry/Ellipse.hpp>
 #include <cctag/geometry/Distance.hpp>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 namespace cctag
@@ -21,6 +23,34 @@ namespace cctag
 
 class CCTag;
 
+/** @brief Set of the edge points reached while growing one candidate ellipse.
+ * An edge point belongs to the set when its stamp equals the current epoch, so clearing
+ * the set only starts a new epoch. One set per thread serves candidate after candidate.
+ */
+class EdgePointVisits
+{
+public:
+  /** @brief Empty the set, making room for the points of a collection of pointCount points. */
+  void clear(std::size_t pointCount)
+  {
+    if (_stamps.size() < pointCount)
+      _stamps.resize(pointCount, 0);
+    if (++_epoch == 0)
+    {
+      std::fill(_stamps.begin(), _stamps.end(), 0);
+      _epoch = 1;
+    }
+  }
+
+  bool test(int i) const { return _stamps[i] == _epoch; }
+
+  void insert(int i) { _stamps[i] = _epoch; }
+
+private:
+  std::vector<uint32_t> _stamps;
+  uint32_t _epoch = 0;
+};
+
 inline bool isInEllipse(
         const cctag::numerical::geometry::Ellipse& ellipse,
         const Point2d<Eigen::Vector3f> & p)
@@ -99,12 +129,12 @@ inline bool isOnTheSameSide(const Point2d<Eigen::Vector3f> & p1, const Point2d<E
 
 /** @brief Search recursively connected points from a point and add it in pts if it is in the ellipse hull
  * @param list of points to complete
+ * @param visited already processed edge points
  * @param img map of edge points
- * @param map of already processed edge points
  * @param abscissa of the point
  * @param ordinate of the point
  */
-void connectedPoint( std::vector<EdgePoint*>& pts, int runId, const EdgePointCollection& img, cctag::numerical::geometry::Ellipse& qIn, cctag::numerical::geometry::Ellipse& qOut, int x, int y );
+void connectedPoint( std::vector<EdgePoint*>& pts, EdgePointVisits& visited, const EdgePointCollection& img, cctag::numerical::geometry::Ellipse& qIn, cctag::numerical::geometry::Ellipse& qOut, int x, int y );
 
 /** @brief Compute the hull from ellipse
  * @param ellipse ellipse from which the hull is computed
@@ -117,18 +147,19 @@ void computeHull( const cctag::numerical::geometry::Ellipse& ellipse, float delt
  * which fits pt. New points will be added in pts
  * @param ellipse ellipse is an optionnal parameter if the user decide to choose his hull from an ellipse
  */
-void ellipseHull( const EdgePointCollection& img, std::vector<EdgePoint*>& pts, cctag::numerical::geometry::Ellipse& ellipse, float delta, std::size_t runId);
+void ellipseHull( const EdgePointCollection& img, std::vector<EdgePoint*>& pts, cctag::numerical::geometry::Ellipse& ellipse, float delta, EdgePointVisits& visited);
 
 /** @brief Ellipse growing
  * @param children vote winner children points
  * @param outerEllipsePoints outer ellipse points
  * @param ellipse target ellipse
  * @param Width of elliptic hull in ellipse growing
+ * @param visited set used to mark the processed edge points, cleared first
  */
 
 void ellipseGrowing2( const EdgePointCollection& img, const std::vector<EdgePoint*>& filteredChildren,
                       std::vector<EdgePoint*>& outerEllipsePoints, numerical::geometry::Ellipse& ellipse,
-                      float ellipseGrowingEllipticHullWidth, std::size_t runId, bool goodInit);
+                      float ellipseGrowingEllipticHullWidth, EdgePointVisits& visited, bool goodInit);
 
 } // namespace cctag
 
@@ -8,6 +8,7 @@
 #pragma once
 
 #include <cctag/utils/VisualDebug.hpp>
+#include <cctag/CCTagMarkersBank.hpp>
 #include <cctag/EllipseGrowing.hpp>
 #include <cctag/ImageCut.hpp>
 #include <cctag/geometry/Ellipse.hpp>
@@ -48,7 +49,7 @@ enum NeighborType {
  * @param[in] tagIndex a sequence number assigned to this tag
  * @param[in] cctag whose center is to be optimized in conjunction with its associated homography.
  * @param[out] vSelectedCuts step 1 does nothing else than create cuts for this tag
- * @param[in] radiusRatios bank of radius ratios along with their associated IDs.
+ * @param[in] bank bank of radius ratios along with their associated IDs.
  * @param[in] src original gray scale image (original scale, uchar)
  * @param[in] params set of parameters
  * @return status of the markers (c.f. all the possible status are located in CCTag.hpp) 
@@ -71,7 +72,7 @@ int identify_step_1(
  * @param[in] tagIndex a sequence number assigned to this tag
  * @param[in] cctag whose center is to be optimized in conjunction with its associated homography.
  * @param[in] vSelectedCuts pre-generated cuts
- * @param[in] radiusRatios bank of radius ratios along with their associated IDs.
+ * @param[in] bank bank of radius ratios along with their associated IDs.
  * @param[in] src original gray scale image (original scale, uchar)
  * @param[in] params set of parameters
  * @return status of the markers (c.f. all the possible status are located in CCTag.hpp) 
@@ -80,13 +81,15 @@ int identify_step_2(
     int tagIndex,
 	CCTag & cctag,
     std::vector<cctag::ImageCut>& vSelectedCuts,
-	const std::vector< std::vector<float> > & radiusRatios,
+	const CCTagMarkersBank & bank,
 	const cv::Mat & src,
     cctag::TagPipe* cudaPipe,
 	const cctag::Parameters & params);
 
 using RadiusRatioBank = std::vector<std::vector<float>>;
 using CutSelectionVec =  std::vector< std::pair< cctag::Point2d<Eigen::Vector3f>, cctag::ImageCut>>;
+/// x and y pixel coordinates of the samples of an image cut, reused from cut to cut.
+using CutCoordinates = std::pair< std::vector<float>, std::vector<float> >;
 
 /**
  * @brief Apply a planar homography to a 2D point.
@@ -115,14 +118,14 @@ inline void applyHomography(
  * @brief Read and identify a 1D rectified image signal.
  * 
  * @param[out] vScore ordered set of the probability of the k nearest IDs
- * @param[in] rrBank Set of vector of radius ratio describing the 1D profile of the cctag library
+ * @param[in] profiles 1D profiles of the cctag library, sampled as the cuts are
  * @param[in] cuts image cuts holding the rectified 1D signal
  * @param[in] minIdentProba minimal probability to considered a cctag as correctly identified
  * @return true if the cctag has been correctly identified, false otherwise
  */
 bool orazioDistanceRobust(
         std::vector<std::list<float> > & vScore,
-        const RadiusRatioBank & rrBank,
+        const CCTagMarkersBank::Profiles & profiles,
         const std::vector<cctag::ImageCut> & cuts,
         float minIdentProba);
 
@@ -133,12 +136,14 @@ bool orazioDistanceRobust(
  * @param[in] src source grayscale image (uchar)
  * @param[in] mHomography image->cctag homography
  * @param[in] mInvHomography cctag>image homography
+ * @param[out] coordinates buffers for the pixel locations of the samples
  */
 void extractSignalUsingHomography(
         cctag::ImageCut & cut,
         const cv::Mat & src,
         const Eigen::Matrix3f & mHomography,
-        const Eigen::Matrix3f & mInvHomography);
+        const Eigen::Matrix3f & mInvHomography,
+        CutCoordinates & coordinates);
 
 /* deprecated */
 void extractSignalUsingHomographyDeprec(
@@ -160,6 +165,14 @@ void cutInterpolated(
         cctag::ImageCut & cut,
         const cv::Mat & src);
 
+/**
+ * @brief Same as above, with caller-provided buffers for the pixel locations of the samples.
+ */
+void cutInterpolated(
+        cctag::ImageCut & cut,
+        const cv::Mat & src,
+        CutCoordinates & coordinates);
+
 std::pair<float,float> convImageCut(const std::vector<float> & kernel, ImageCut & cut);
 
 void blurImageCut(float sigma, cctag::ImageCut & cut);
@@ -181,8 +194,8 @@ void collectCuts(
         const cv::Mat & src,
         const cctag::Point2d<Eigen::Vector3f> & center,
         const std::vector< cctag::DirectedPoint2d<Eigen::Vector3f> > & outerPoints,
-        std::size_t sampleCutLength,
-        std::size_t startOffset );
+        std::size_t nSamplesInCut,
+        float beginSig );
 
 /*
  * @brief Bilinear interpolation for a point whose coordinates are (x,y)
@@ -219,6 +232,18 @@ inline float getPixelBilinear(const cv::Mat & src, float x, float y)
   return (p1 * w1 + p2 * w2 + p3 * w3 + p4 * w4)/2;
 }
 
+/**
+ * @brief Bilinear interpolation of a batch of image locations, 8 at a time with AVX2.
+ * All the locations must lie in [0,src.cols-1[ x [0,src.rows-1[.
+ * 
+ * @param[in] src source gray scale image (uchar)
+ * @param[in] xs x coordinates
+ * @param[in] ys y coordinates
+ * @param[in] n number of locations
+ * @param[out] values computed pixel values, as getPixelBilinear
+ */
+void getPixelsBilinear(const cv::Mat & src, const float* xs, const float* ys, std::size_t n, float* values);
+
 /**
  * @brief Collect rectified 1D signals along image cuts.
  * 
@@ -282,6 +307,30 @@ bool imageCenterOptimizationGlob(
         const cctag::Parameters & params );
 
 
+/**
+ * @brief Nelder-Mead optimization of the imaged center, an alternative to the
+ * successive grids of imageCenterOptimizationGlob.
+ * 
+ * @param[out] mHomography optimal homography from the pixel plane to the cctag plane.
+ * @param[out] vCuts vector of the image cuts, their signal is overwritten by each evaluation
+ * @param[in-out] center optimal imaged center
+ * @param[out] minRes residual after optimization
+ * @param[in] neighbourSize size of the initial simplex relatively to the outer ellipse dimensions
+ * @param[in] src source gray (uchar) image
+ * @param[in] outerEllipse outer ellipse
+ * @param[in] params Parameters read from config file
+ * @return true if at least one evaluated center has readable cuts.
+ */
+bool imageCenterOptimizationSimplex(
+        Eigen::Matrix3f & mHomography,
+        std::vector< cctag::ImageCut > & vCuts,
+        cctag::Point2d<Eigen::Vector3f> & center,
+        float & minRes,
+        float neighbourSize,
+        const cv::Mat & src, 
+        const cctag::numerical::geometry::Ellipse & outerEllipse,
+        const cctag::Parameters & params );
+
 /**
  * @brief Compute a set of point locations nearby a given center following
  * a given type of pattern (e.g. regularly sampled points over a grid)
@@ -314,6 +363,19 @@ void computeHomographyFromEllipseAndImagedCenter(
         const cctag::Point2d<Eigen::Vector3f> & center,
         Eigen::Matrix3f & mHomography);
 
+/**
+ * @brief Average over all the cut-pairs within the image bounds of the sum of the square
+ * of the differences between their rectified image signals, computed in linear time in
+ * the number of cuts.
+ * 
+ * @param[in] vCuts vector of the image cuts holding the rectified signal, all of the same length
+ * @param[out] flag: true if at least one cut-pair is readable (within the image bounds), false otherwise.
+ * @return residual
+ */
+float signalsResidual(
+        const std::vector< cctag::ImageCut > & vCuts,
+        bool & flag);
+
 /**
  * @brief Compute the residual of the optimization which is the average of the square of the 
  * differences between two rectified image signals/cuts over all possible cut-pair in a set 
@@ -331,6 +393,12 @@ float costFunctionGlob(
         const cv::Mat & src,
         bool & flag);
 
+/**
+ * @brief Number of calls to costFunctionGlob since the start of the program, from all threads.
+ * Used to compare the cost of the imaged center optimizations.
+ */
+std::size_t costFunctionGlobEvaluations();
+
 
 /**
  * @brief COmpute a median value from a vector of scalar values
@@ -11,6 +11,8 @@
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include <tbb/tbb.h>
+
 #include <iostream>
 #include <string>
 
@@ -44,12 +46,28 @@ void ImagePyramid::build( const cv::Mat & src, float thrLowCanny, float thrHighC
 
     /* The pyramid building function is never called if CUDA is used.
      */
+#ifndef CCTAG_SERIALIZE
+  // Each level is downsampled from the previous one as soon as that one is resized; the
+  // edges of the levels are extracted concurrently meanwhile.
+  tbb::task_group edgeExtraction;
+
+  _levels[0]->resizeFrom( src );
+  for(int i = 0; i < _levels.size() ; ++i)
+  {
+    Level* level = _levels[i];
+    edgeExtraction.run( [=]() { level->extractEdges( thrLowCanny, thrHighCanny, params ); } );
+    if( i + 1 < _levels.size() )
+      _levels[i+1]->resizeFrom( level->getSrc() );
+  }
+  edgeExtraction.wait();
+#else
   _levels[0]->setLevel( src , thrLowCanny, thrHighCanny, params );
   
   for(int i = 1; i < _levels.size() ; ++i)
   {
     _levels[i]->setLevel( _levels[i-1]->getSrc(), thrLowCanny, thrHighCanny, params );
   }
+#endif
   
 #ifdef CCTAG_SERIALIZE
   for(int i = 0; i < _levels.size() ; ++i)
@@ -64,13 +64,25 @@ void Level::setLevel( const cv::Mat & src,
         exit( -__LINE__ );
     }
 
+    resizeFrom( src );
+    extractEdges( thrLowCanny, thrHighCanny, params );
+}
+
+void Level::resizeFrom( const cv::Mat & src )
+{
     cv::resize( src, *_src, cv::Size(_src->cols,_src->rows) );
+}
+
+void Level::extractEdges( float thrLowCanny,
+                          float thrHighCanny,
+                          const cctag::Parameters* params )
+{
     // ASSERT TODO : check that the data are allocated here
     // Compute derivative and canny edge extraction.
     cvRecodedCanny( *_src, *_edges, *_dx, *_dy,
                     thrLowCanny * 256, thrHighCanny * 256,
                     3 | CV_CANNY_L2_GRADIENT,
-                    _level, params );
+                    _level, params, &_cannyBuffers );
     // Perform the thinning.
 
 #ifdef CCTAG_EXTRA_LAYER_DEBUG
@@ -8,6 +8,8 @@
 #ifndef _CCTAG_LEVEL_HPP
 #define	_CCTAG_LEVEL_HPP
 
+#include <cctag/filter/cvRecode.hpp>
+
 #include <opencv2/opencv.hpp>
 
 namespace cctag {
@@ -30,6 +32,15 @@ public:
                  float thrLowCanny,
                  float thrHighCanny,
                  const cctag::Parameters* params );
+
+  /* The two steps of setLevel: resizing src into the level source image, then the edge
+   * extraction on it. Once resized, the source of a level can be used to build the next
+   * level while the edges are extracted.
+   */
+  void resizeFrom( const cv::Mat & src );
+  void extractEdges( float thrLowCanny,
+                     float thrHighCanny,
+                     const cctag::Parameters* params );
 #ifdef CCTAG_WITH_CUDA
   void setLevel( cctag::TagPipe* cuda_pipe,
                  const cctag::Parameters& params );
@@ -69,6 +80,7 @@ private:
   cv::Mat* _src;
   cv::Mat* _edges;
   cv::Mat  _temp;
+  CannyBuffers _cannyBuffers; // reused by the edge extraction of every frame
   
 #ifdef CCTAG_EXTRA_LAYER_DEBUG
   cv::Mat _edgesNotThin;
@@ -19,10 +19,18 @@
 #include <boost/timer/timer.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <tbb/tbb.h>
+
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
 
 #include <limits>
 
@@ -169,27 +177,185 @@ static void selectEdgePointInEllipticHull(
   }
 }
 
-void update(
-        CCTag::List& markers,
-        const CCTag& markerToAdd)
+namespace {
+
+/**
+ * @brief Radius of the disk around the center of a marker used by CCTag::isEqual:
+ * two markers are equal when the center of one lies in the disk of the other.
+ */
+inline float equalityRadius(const CCTag& marker)
+{
+  return 0.5f * marker.rescaledOuterEllipse().b();
+}
+
+/**
+ * @brief Uniform grid over the image holding the markers kept by the overlap
+ * suppression, bucketed by the center of their rescaled outer ellipse.
+ */
+class MarkerGrid
+{
+public:
+  explicit MarkerGrid(float cellSize)
+    : _cellSize(cellSize)
+  {
+  }
+
+  void insert(std::size_t slot, const Point2d<Eigen::Vector3f>& center)
+  {
+    _cells[key(cell(center.x()), cell(center.y()))].push_back(slot);
+  }
+
+  void erase(std::size_t slot, const Point2d<Eigen::Vector3f>& center)
+  {
+    std::vector<std::size_t>& slots = _cells[key(cell(center.x()), cell(center.y()))];
+    slots.erase(std::find(slots.begin(), slots.end(), slot));
+  }
+
+  /// Collect the slots of the cells intersecting the square of half side radius around center.
+  void neighbours(const Point2d<Eigen::Vector3f>& center, float radius, std::vector<std::size_t>& slots) const
+  {
+    slots.clear();
+    const std::int64_t xMin = cell(center.x() - radius), xMax = cell(center.x() + radius);
+    const std::int64_t yMin = cell(center.y() - radius), yMax = cell(center.y() + radius);
+    for (std::int64_t y = yMin; y <= yMax; ++y)
+    {
+      for (std::int64_t x = xMin; x <= xMax; ++x)
+      {
+        const auto found = _cells.find(key(x, y));
+        if (found != _cells.end())
+        {
+          slots.insert(slots.end(), found->second.begin(), found->second.end());
+        }
+      }
+    }
+  }
+
+private:
+  std::int64_t cell(float coordinate) const
+  {
+    return static_cast<std::int64_t>(std::floor(coordinate / _cellSize));
+  }
+
+  static std::uint64_t key(std::int64_t x, std::int64_t y)
+  {
+    return (std::uint64_t(x) << 32) ^ std::uint32_t(y);
+  }
+
+  float _cellSize;
+  std::unordered_map<std::uint64_t, std::vector<std::size_t>> _cells;
+};
+
+/**
+ * @brief One pass of overlap suppression: the markers are added in the given order,
+ * a marker equal to kept ones replaces those of lower quality, otherwise it is kept.
+ * 
+ * @param[in] markers all the markers
+ * @param[in] order indices in markers of the markers to add
+ * @return for each kept slot, the index in markers of the marker it holds
+ */
+std::vector<std::size_t> suppressOverlaps(
+        const std::vector<const CCTag*>& markers,
+        const std::vector<std::size_t>& order)
 {
-  bool flag = false;
+  // Markers are equal within about their radius: with cells as large as the largest
+  // radius, the lookup only visits the cells next to the marker.
+  float cellSize = 1.f;
+  for (std::size_t iMarker : order)
+  {
+    const float radius = equalityRadius(*markers[iMarker]);
+    if (std::isfinite(radius))
+      cellSize = std::max(cellSize, radius);
+  }
 
-  for(CCTag & currentMarker : markers)
+  MarkerGrid grid(cellSize);
+  std::vector<std::size_t> kept;
+  kept.reserve(order.size());
+  std::vector<std::size_t> neighbours;
+  float maxRadius = 0.f;
+
+  for (std::size_t iMarker : order)
   {
-    if ( ( currentMarker.getStatus() > 0 ) && ( markerToAdd.getStatus() > 0 ) && currentMarker.isEqual(markerToAdd) )
+    const CCTag& markerToAdd = *markers[iMarker];
+    const Point2d<Eigen::Vector3f>& center = markerToAdd.rescaledOuterEllipse().center();
+    const float radius = equalityRadius(markerToAdd);
+    const bool indexable = std::isfinite(center.x()) && std::isfinite(center.y()) && std::isfinite(radius);
+
+    bool flag = false;
+    if (markerToAdd.getStatus() > 0 && indexable)
+    {
+      // Conservative search radius, isEqual being the actual test.
+      grid.neighbours(center, std::max(radius, maxRadius) * 1.01f + 1.f, neighbours);
+      for (std::size_t slot : neighbours)
+      {
+        const CCTag& currentMarker = *markers[kept[slot]];
+        if (currentMarker.getStatus() > 0 && currentMarker.isEqual(markerToAdd))
+        {
+          if (markerToAdd.quality() > currentMarker.quality())
+          {
+            grid.erase(slot, currentMarker.rescaledOuterEllipse().center());
+            grid.insert(slot, center);
+            kept[slot] = iMarker;
+            maxRadius = std::max(maxRadius, radius);
+          }
+          flag = true;
+        }
+      }
+    }
+
+    if (!flag)
     {
-      if (markerToAdd.quality() > currentMarker.quality())
+      // Markers without a positive status are never looked up.
+      if (markerToAdd.getStatus() > 0 && indexable)
       {
-        currentMarker = markerToAdd;
+        grid.insert(kept.size(), center);
+        maxRadius = std::max(maxRadius, radius);
       }
-      flag = true;
+      kept.push_back(iMarker);
     }
   }
-  if (!flag)
+  return kept;
+}
+
+} // namespace
+
+void removeOverlappingMarkers(CCTag::List& markers)
+{
+  std::vector<CCTag::List::iterator> handles;
+  std::vector<const CCTag*> pMarkers;
+  handles.reserve(markers.size());
+  pMarkers.reserve(markers.size());
+  for (auto it = markers.begin(); it != markers.end(); ++it)
+  {
+    handles.push_back(it);
+    pMarkers.push_back(&*it);
+  }
+
+  std::vector<std::size_t> order(markers.size());
+  std::iota(order.begin(), order.end(), std::size_t(0));
+
+  // The suppression is run twice, the second pass over the markers kept by the first.
+  const std::vector<std::size_t> kept = suppressOverlaps(pMarkers, suppressOverlaps(pMarkers, order));
+
+  // A marker that replaced several others is kept several times: it is copied for all
+  // but its first slot, the other kept markers are moved out of the input list.
+  std::vector<char> used(markers.size(), false);
+  std::vector<std::unique_ptr<CCTag>> copies(kept.size());
+  for (std::size_t slot = 0; slot < kept.size(); ++slot)
+  {
+    if (used[kept[slot]])
+      copies[slot].reset(new CCTag(*pMarkers[kept[slot]]));
+    used[kept[slot]] = true;
+  }
+
+  CCTag::List result;
+  for (std::size_t slot = 0; slot < kept.size(); ++slot)
   {
-    markers.push_back(new CCTag(markerToAdd));
+    if (copies[slot])
+      result.push_back(copies[slot].release());
+    else
+      result.transfer(result.end(), handles[kept[slot]], markers);
   }
+  markers.swap(result);
 }
 
 static void cctagMultiresDetection_inner(
@@ -235,11 +401,6 @@ static void cctagMultiresDetection_inner(
           level->getDx(),
           level->getDy(),
           params );
-    
-    if( seeds.size() > 1 ) {
-        // Sort the seeds based on the number of received votes.
-        std::sort(seeds.begin(), seeds.end(), receivedMoreVoteThan);
-    }
 
 #if defined(CCTAG_WITH_CUDA)
     } // not cuda_pipe
@@ -272,6 +433,7 @@ void cctagMultiresDetection(
         std::size_t   frame,
         cctag::TagPipe*    cuda_pipe,
         const Parameters&   params,
+        DetectionSession&   session,
         cctag::logtime::Mgmt* durations )
 {
   //	* For each pyramid level:
@@ -280,19 +442,21 @@ void cctagMultiresDetection(
   // std::map<std::size_t, CCTag::List> pyramidMarkers;
   const int numProcLayers = params._numberOfProcessedMultiresLayers;
 
-  std::vector<std::unique_ptr<EdgePointCollection> > vEdgePointCollections( numProcLayers );
+  std::vector<EdgePointCollection*> vEdgePointCollections( numProcLayers );
   for( int i = 0; i<numProcLayers; i++ )
   {
-    vEdgePointCollections[i].reset(new EdgePointCollection(imgGraySrc.cols, imgGraySrc.rows));
+    // Sized on the level, edge points never lie outside of it.
+    const Level* level = imagePyramid.getLevel(i);
+    vEdgePointCollections[i] = &session.edgeCollection(i, level->width(), level->height());
   }
 
   BOOST_ASSERT( params._numberOfMultiresLayers - numProcLayers >= 0 );
-  for( int i = numProcLayers-1; i >= 0; i-- )
+  std::vector<CCTag::List> pyramidMarkers( numProcLayers );
+
+  auto detectInLevel = [&]( int i )
   {
-    CCTag::List pyramidMarkers;
-    
     cctagMultiresDetection_inner( i,
-                                  pyramidMarkers,
+                                  pyramidMarkers[i],
                                   imgGraySrc,
                                   imagePyramid.getLevel(i),
                                   frame,
@@ -300,12 +464,26 @@ void cctagMultiresDetection(
                                   cuda_pipe,
                                   params,
                                   durations );
+  };
 
-    // Gather the detected markers in the entire image pyramid
-    for(const CCTag & marker : pyramidMarkers)
-    {
-      markers.push_back( new CCTag(marker) );
-    }
+  // The levels only share read-only data on the CPU, they are processed concurrently.
+  // The CUDA pipe hands the levels over one after the other.
+#ifndef CCTAG_SERIALIZE
+  if( !cuda_pipe )
+  {
+    tbb::parallel_for( 0, numProcLayers, detectInLevel );
+  }
+  else
+#endif
+  {
+    for( int i = numProcLayers-1; i >= 0; i-- )
+      detectInLevel( i );
+  }
+
+  // Gather the detected markers in the entire image pyramid, from the coarsest level
+  for( int i = numProcLayers-1; i >= 0; i-- )
+  {
+    markers.transfer( markers.end(), pyramidMarkers[i] );
   }
   if( durations ) durations->log( "after cctagMultiresDetection_inner" );
   
@@ -9,6 +9,7 @@
 #define VISION_CCTAG_MULTIRESOLUTION_HPP_
 
 #include <cctag/CCTag.hpp>
+#include <cctag/DetectionSession.hpp>
 #include <cctag/Params.hpp>
 #include <cctag/geometry/Ellipse.hpp>
 #include <cctag/geometry/Circle.hpp>
@@ -34,6 +35,7 @@ struct CCTagParams
  * @param[out] markers detected cctags
  * @param[in] srcImg
  * @param[in] frame
+ * @param[in] session provides the edge point collections of the processed levels
  * 
  */
 
@@ -44,9 +46,18 @@ void cctagMultiresDetection(
         std::size_t   frame,
         cctag::TagPipe*    cuda_pipe,
         const Parameters&   params,
+        DetectionSession&   session,
         cctag::logtime::Mgmt* durations );
 
-void update(CCTag::List& markers, const CCTag& markerToAdd);
+/**
+ * @brief Delete overlapping markers while keeping the best ones: a marker equal
+ * (c.f. CCTag::isEqual) to a previous one of positive status replaces it if its
+ * quality is higher, and is dropped otherwise. The markers are processed in list
+ * order, twice, and the survivors are moved out of markers rather than copied.
+ * 
+ * @param[inout] markers markers to filter
+ */
+void removeOverlappingMarkers(CCTag::List& markers);
 
 } // namespace cctag
 
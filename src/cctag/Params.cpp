@@ -70,6 +70,9 @@ Parameters::Parameters(std::size_t nCrowns)
   , _useCuda(kDefaultUseCuda)
   , _pinnedCounters( kDefaultPinnedCounters )
   , _pinnedNearbyPoints( kDefaultPinnedNearbyPoints )
+  , _parallelHysteresis( kDefaultParallelHysteresis )
+  , _imagedCenterSimplex( kDefaultImagedCenterSimplex )
+  , _imagedCenterMaxIterations( kDefaultImagedCenterMaxIterations )
   , _debugDir("")
 {
     _nCircles = 2 * _nCrowns;
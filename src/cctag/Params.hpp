@@ -10,6 +10,7 @@
 #include <boost/math/constants/constants.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/version.hpp>
 #include <sys/stat.h>  // needed for stat and mkdir
 #include <sys/types.h> // needed for stat and mkdir
 
@@ -64,6 +65,9 @@ static constexpr bool kDefaultUseCuda = false;
 #endif
 static constexpr size_t kDefaultPinnedCounters     = 100;
 static constexpr size_t kDefaultPinnedNearbyPoints = 60;
+static constexpr bool kDefaultParallelHysteresis = false;
+static constexpr bool kDefaultImagedCenterSimplex = false;
+static constexpr std::size_t kDefaultImagedCenterMaxIterations = 100;
 
 static const std::string kParamCannyThrLow("kParamCannyThrLow");
 static const std::string kParamCannyThrHigh("kParamCannyThrHigh");
@@ -99,6 +103,9 @@ static const std::string kParamMaxEdges("kParamMaxEdges");
 static const std::string kUseCuda("kUseCuda");
 static const std::string kPinnedCounters("kPinnedCounters");
 static const std::string kPinnedNearbyPoints("kPinnedNearbyPoints");
+static const std::string kParamParallelHysteresis("kParamParallelHysteresis");
+static const std::string kParamImagedCenterSimplex("kParamImagedCenterSimplex");
+static const std::string kParamImagedCenterMaxIterations("kParamImagedCenterMaxIterations");
 
 static const std::size_t kWeight = INV_GRAD_WEIGHT;
 
@@ -198,6 +205,14 @@ struct Parameters
      */
     size_t _pinnedNearbyPoints;
 
+    ///  run the Canny hysteresis as a parallel connected-component labelling instead of the serial edge tracking
+    bool _parallelHysteresis;
+
+    ///  optimize the imaged center with a Nelder-Mead simplex instead of successively refined grids
+    bool _imagedCenterSimplex;
+    ///  maximal number of iterations of the simplex optimization of the imaged center
+    std::size_t _imagedCenterMaxIterations;
+
     ///  prefix for debug output
     std::string _debugDir;
 
@@ -244,6 +259,13 @@ struct Parameters
         ar& BOOST_SERIALIZATION_NVP(_useCuda);
         ar& BOOST_SERIALIZATION_NVP(_pinnedCounters);
         ar& BOOST_SERIALIZATION_NVP(_pinnedNearbyPoints);
+        // Files saved before version 1 keep the default of the parameters added since.
+        if(version >= 1)
+        {
+            ar& BOOST_SERIALIZATION_NVP(_parallelHysteresis);
+            ar& BOOST_SERIALIZATION_NVP(_imagedCenterSimplex);
+            ar& BOOST_SERIALIZATION_NVP(_imagedCenterMaxIterations);
+        }
         _nCircles = 2 * _nCrowns;
     }
 
@@ -262,3 +284,5 @@ struct Parameters
 };
 
 } // namespace cctag
+
+BOOST_CLASS_VERSION(cctag::Parameters, 1)
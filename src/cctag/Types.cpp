@@ -8,32 +8,85 @@
 
 #include <cctag/Types.hpp>
 
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+
 namespace cctag
 {
 
-EdgePointCollection::EdgePointCollection(size_t w, size_t h) :
-  _edgeMap(new int[MAX_RESOLUTION*MAX_RESOLUTION]),
-  _edgeList(new EdgePoint[MAX_POINTS]),
-  _linkList(new int[2*MAX_POINTS]),
-  _votersIndex(new int[MAX_POINTS+CUDA_OFFSET]),
-  _votersList(new int[MAX_VOTERLIST_SIZE]),
-  _processedIn(new unsigned[MAX_POINTS/4]),
-  _processedAux(new unsigned[MAX_POINTS/4])
+EdgePointCollection::EdgePointCollection(size_t w, size_t h, size_t maxPoints)
+{
+  allocate_points(maxPoints);
+  reset(w, h);
+}
+
+void EdgePointCollection::allocate_points(size_t n)
+{
+  if (n > MAX_POINTS)
+    throw std::length_error(std::string("EdgePointCollection::reserve: too many edge points (nb points: ") + std::to_string(n) + ", max: " + std::to_string(MAX_POINTS) + ")");
+
+  const size_t words = (n + 31) / 32;
+  _edgeList.reset(new EdgePoint[n]);
+  _linkList.reset(new int[2*n]);
+  _votersIndex.reset(new int[n+1+CUDA_OFFSET]);
+  _processedIn.reset(new unsigned[words]);
+  _processedAux.reset(new unsigned[words]);
+  _pointCapacity = n;
+
+  point_count() = 0;
+  memset(&_processedIn[0], 0, words*sizeof(unsigned));
+  memset(&_processedAux[0], 0, words*sizeof(unsigned));
+}
+
+void EdgePointCollection::reset(size_t w, size_t h)
 {
   if (w*h > MAX_RESOLUTION*MAX_RESOLUTION)
-    throw std::length_error("EdgePointCollection::set_frame_size: image resolution is too large");
+    throw std::length_error("EdgePointCollection::reset: image resolution is too large");
+
+  const size_t nPoints = point_count();
+  const size_t words = (nPoints + 31) / 32;
+
+  // Only the bits of the previous points can be set.
+  memset(&_processedIn[0], 0, words*sizeof(unsigned));
+  memset(&_processedAux[0], 0, words*sizeof(unsigned));
+
+  if (w == _edgeMapShape[0] && h == _edgeMapShape[1])
+  {
+    // Same frame size: the map is -1 everywhere but at the previous points.
+    for (size_t i = 0; i < nPoints; ++i)
+      _edgeMap[map_index(_edgeList[i].x(), _edgeList[i].y())] = -1;
+  }
+  else
+  {
+    if (w*h > _mapCapacity)
+    {
+      _edgeMap.reset(new int[w*h]);
+      _mapCapacity = w*h;
+    }
+    memset(&_edgeMap[0], -1, w*h*sizeof(int));  // XXX@stian: unnecessary for CUDA
+  }
 
   point_count() = 0;
   _edgeMapShape[0] = w; _edgeMapShape[1] = h;
-  memset(&_edgeMap[0], -1, w*h*sizeof(int));  // XXX@stian: unnecessary for CUDA
-  
-  if (w*h/8+4 < MAX_POINTS) {
-    memset(&_processedIn[0], 0, w*h/8+4);     // one bit per pixel + roundoff error
-    memset(&_processedAux[0], 0, w*h/8+4);    // ditto.
-  }
-  else {
-    memset(&_processedIn[0], 0, MAX_POINTS);
-    memset(&_processedAux[0], 0, MAX_POINTS);
+}
+
+void EdgePointCollection::reserve(size_t maxPoints)
+{
+  if (point_count() != 0)
+    throw std::logic_error("EdgePointCollection::reserve: the collection is not empty");
+
+  if (maxPoints > _pointCapacity)
+  {
+    // Headroom for the next frames, within MAX_POINTS; a larger request is left to
+    // allocate_points() to reject.
+    if (maxPoints > MAX_POINTS)
+      allocate_points(maxPoints);
+    else
+      allocate_points(std::min(maxPoints + maxPoints/4, size_t(MAX_POINTS)));
   }
 }
 
@@ -49,8 +102,8 @@ void EdgePointCollection::add_point(int vx, int vy, float vdx, float vdy)
   // XXX@stian: new() below is technically UB, but the class has no defined dtors
   // so it's safe to re-new it in place w/o calling the dtor firs.
   
-  if (point_count() >= MAX_POINTS)
-    throw std::logic_error(std::string("EdgePointCollection::add_point: too many edge points (nb points: ") + std::to_string(point_count()) + ", max: " + std::to_string(MAX_POINTS) + ")");
+  if (point_count() >= _pointCapacity)
+    throw std::logic_error(std::string("EdgePointCollection::add_point: too many edge points (nb points: ") + std::to_string(point_count()) + ", reserved: " + std::to_string(_pointCapacity) + ")");
   
   size_t ipoint = point_count()++;
   _edgeMap[imap] = ipoint;
@@ -72,8 +125,14 @@ void EdgePointCollection::create_voter_lists(const std::vector<std::vector<int>>
   for (size_t i = 0; i < point_count(); ++i)
     _votersIndex[i+1+CUDA_OFFSET] = (int)(_votersIndex[i+CUDA_OFFSET] + voter_lists[i].size());
   
-  if (_votersIndex[point_count()+CUDA_OFFSET] > MAX_VOTERLIST_SIZE)
+  const size_t nVoters = _votersIndex[point_count()+CUDA_OFFSET];
+  if (nVoters > MAX_VOTERLIST_SIZE)
     throw std::length_error("EdgePointCollection::create_voters_lists: too many voters");
+  if (nVoters > _voterCapacity)
+  {
+    _voterCapacity = std::min(nVoters + nVoters/4, size_t(MAX_VOTERLIST_SIZE));
+    _votersList.reset(new int[_voterCapacity]);
+  }
   
   int *p = &_votersList[0];
   for (const auto& vlist: voter_lists)
@@ -83,4 +142,71 @@ void EdgePointCollection::create_voter_lists(const std::vector<std::vector<int>>
     throw std::logic_error("EdgePointCollection::create_voters_lists: invalid count copied");
 }
 
+void EdgePointCollection::create_voter_lists(const std::vector<int>& votes)
+{
+  if (votes.size() != point_count())
+    throw std::length_error("EdgePointCollection::create_voters_lists: inconsistent sizes");
+
+  const int pointCount = point_count();
+
+  // number of voters of every point, then the next free slot of its list
+  std::vector<std::atomic<int>> slots(pointCount);
+
+#ifndef CCTAG_SERIALIZE
+  tbb::parallel_for(0, pointCount, [&](int i) {
+#else
+  for (int i = 0; i < pointCount; ++i) {
+#endif
+    if (votes[i] >= 0)
+      slots[votes[i]].fetch_add(1, std::memory_order_relaxed);
+#ifndef CCTAG_SERIALIZE
+  });
+#else
+  }
+#endif
+
+  _votersIndex[0+CUDA_OFFSET] = 0;
+  for (int i = 0; i < pointCount; ++i)
+    _votersIndex[i+1+CUDA_OFFSET] = _votersIndex[i+CUDA_OFFSET] + slots[i].load(std::memory_order_relaxed);
+
+  const size_t nVoters = _votersIndex[pointCount+CUDA_OFFSET];
+  if (nVoters > MAX_VOTERLIST_SIZE)
+    throw std::length_error("EdgePointCollection::create_voters_lists: too many voters");
+  if (nVoters > _voterCapacity)
+  {
+    _voterCapacity = std::min(nVoters + nVoters/4, size_t(MAX_VOTERLIST_SIZE));
+    _votersList.reset(new int[_voterCapacity]);
+  }
+
+  for (int i = 0; i < pointCount; ++i)
+    slots[i].store(_votersIndex[i+CUDA_OFFSET], std::memory_order_relaxed);
+
+  int* list = &_votersList[0];
+#ifndef CCTAG_SERIALIZE
+  tbb::parallel_for(0, pointCount, [&](int i) {
+#else
+  for (int i = 0; i < pointCount; ++i) {
+#endif
+    if (votes[i] >= 0)
+      list[slots[votes[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+#ifndef CCTAG_SERIALIZE
+  });
+#else
+  }
+#endif
+
+  // the scatter order depends on the scheduling, the lists are put back in voter order
+#ifndef CCTAG_SERIALIZE
+  tbb::parallel_for(0, pointCount, [&](int i) {
+#else
+  for (int i = 0; i < pointCount; ++i) {
+#endif
+    std::sort(list + _votersIndex[i+CUDA_OFFSET], list + _votersIndex[i+1+CUDA_OFFSET]);
+#ifndef CCTAG_SERIALIZE
+  });
+#else
+  }
+#endif
+}
+
 } // namespace cctag
@@ -31,6 +31,8 @@ public:
   
 private:
   // These must be exported also by CUDA.
+  // All the buffers are sized on demand (see reset() and reserve()) and are never shrunk,
+  // so that a collection reused for frames of the same size stops allocating.
   std::unique_ptr<int[]> _edgeMap;
   std::unique_ptr<EdgePoint[]> _edgeList;
   std::unique_ptr<int[]> _linkList;     // even idx: before, odd: after
@@ -41,6 +43,9 @@ private:
   std::unique_ptr<unsigned[]> _processedIn;
   std::unique_ptr<unsigned[]> _processedAux;
   size_t _edgeMapShape[2]{};
+  size_t _mapCapacity = 0;    // ints in _edgeMap
+  size_t _pointCapacity = 0;  // points in _edgeList; also sizes _linkList, _votersIndex and the bit sets
+  size_t _voterCapacity = 0;  // ints in _votersList
   
   static_assert(sizeof(unsigned) == 4, "unsigned has wrong size");
   
@@ -48,21 +53,23 @@ private:
   int point_count() const { return _votersIndex[0]; }
   size_t map_index(int x, int y) const { return x + y * _edgeMapShape[0]; }
   
-  static void set_bit(unsigned* v, size_t i, bool f)
+  void set_bit(unsigned* v, size_t i, bool f) const
   {
-    if (i >= MAX_POINTS)
+    if (i >= _pointCapacity)
       throw std::out_of_range("EdgePointCollection::set_bit");
-    if (f) v[i/4] |=   1U << (i & 31);
-    else   v[i/4] &= ~(1U << (i & 31));
+    if (f) v[i/32] |=   1U << (i & 31);
+    else   v[i/32] &= ~(1U << (i & 31));
   }
   
-  static bool test_bit(unsigned* v, size_t i)
+  bool test_bit(unsigned* v, size_t i) const
   {
-    if (i >= MAX_POINTS)
+    if (i >= _pointCapacity)
       throw std::out_of_range("EdgePointCollection::test_bit");
-    return v[i/4] & (1U << (i & 31));
+    return v[i/32] & (1U << (i & 31));
   }
   
+  void allocate_points(size_t n);
+  
 public:
   EdgePointCollection() = default;
   
@@ -70,11 +77,28 @@ public:
   
   EdgePointCollection& operator=(const EdgePointCollection&) = delete;
   
-  EdgePointCollection(size_t w, size_t h);
+  /**
+   * @brief Create an empty collection for a frame of size w x h able to hold maxPoints points
+   * without reallocating. See reserve().
+   */
+  EdgePointCollection(size_t w, size_t h, size_t maxPoints = 0);
+
+  /**
+   * @brief Remove all the points and prepare the collection for a new frame of size w x h.
+   * When the size is unchanged, only the edge map entries of the removed points are cleared.
+   */
+  void reset(size_t w, size_t h);
+
+  /**
+   * @brief Make room for maxPoints points. Must be called on an empty collection (i.e. after
+   * reset()), before the points are added: add_point() never reallocates since EdgePoint pointers
+   * are handed out.
+   */
+  void reserve(size_t maxPoints);
     
   void add_point(int vx, int vy, float vdx, float vdy);
   
-  int get_point_count()
+  int get_point_count() const
   {
     return point_count();
   }
@@ -98,6 +122,13 @@ public:
 
   void create_voter_lists(const std::vector<std::vector<int>>& voter_lists);
 
+  /**
+   * Build the voter lists from the vote of every point: votes[i] is the index of the point
+   * that point i voted for, or -1. The votes are counted and scattered in parallel; every
+   * list is sorted by voter index, as create_voter_lists above would produce it.
+   */
+  void create_voter_lists(const std::vector<int>& votes);
+
   voter_list voters(const EdgePoint* p) const
   {
     int i = (*this)(p);
@@ -30,10 +30,13 @@
 
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <tbb/tbb.h>
+
 #include <deque>
 #include <array>
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <ostream>
 
 #define EDGE_NOT_FOUND -1
@@ -42,6 +45,94 @@
 
 namespace cctag {
 
+/* Brief: Follow the field line from p, alternately against and along the gradient
+ * direction, through the before/after links of the edge points. The edge point reached
+ * after crossing 2 * nCrowns - 1 sub-segments is returned if all gradient orientations
+ * are consistent and all sub-segment lengths lie within a factor _ratioVoting of each
+ * other, nullptr otherwise.
+ * NCrowns: number of crowns if known at compile time, 0 to read it from params.
+ * totalDistance: length of the polygonal line.
+ */
+template<std::size_t NCrowns>
+static EdgePoint* fieldLineWinner(
+        const EdgePointCollection& edgeCollection,
+        EdgePoint& p,
+        const Parameters & params,
+        float& totalDistance)
+{
+    const std::size_t nCrowns = NCrowns != 0 ? NCrowns : params._nCrowns;
+
+    totalDistance = 0.f;
+
+    // Alternate from the edge point found in the direction opposed to the gradient
+    // direction.
+    EdgePoint* current = edgeCollection.before(&p);
+    // Here current contains the edge point lying on the 2nd ellipse (from outer to inner)
+    if (current == nullptr || !(-p.gradient().dot(current->gradient()) >= params._angleVoting))
+        return nullptr;
+
+    float dist = cctag::numerical::distancePoints2D(p, *current);
+    totalDistance += dist;
+
+    // All sub-segment lengths are within the ratio of each other iff the longest one is
+    // within the ratio of the shortest one.
+    float minDist = dist;
+    float maxDist = dist;
+
+    // Iterate over all crowns
+    for (std::size_t i = 1; i < nCrowns; ++i)
+    {
+        // First in the gradient direction
+        EdgePoint* target = edgeCollection.after(current);
+        if (target == nullptr || !(-target->gradient().dot(current->gradient()) >= params._angleVoting))
+            return nullptr;
+
+        dist = cctag::numerical::distancePoints2D(*target, *current);
+        totalDistance += dist;
+        minDist = std::min(minDist, dist);
+        maxDist = std::max(maxDist, dist);
+        if (!(maxDist <= minDist * params._ratioVoting))
+            return nullptr;
+        current = target;
+
+        // Second in the opposite gradient direction
+        target = edgeCollection.before(current);
+        if (target == nullptr || !(-target->gradient().dot(current->gradient()) >= params._angleVoting))
+            return nullptr;
+
+        dist = cctag::numerical::distancePoints2D(*target, *current);
+        totalDistance += dist;
+        minDist = std::min(minDist, dist);
+        maxDist = std::max(maxDist, dist);
+        if (!(maxDist <= minDist * params._ratioVoting))
+            return nullptr;
+        current = target;
+    }
+    return nCrowns > 1 ? current : nullptr;
+}
+
+template<std::size_t NCrowns>
+static void followFieldLines(
+        const EdgePointCollection& edgeCollection,
+        const Parameters & params,
+        std::vector<int>& votes,
+        std::vector<float>& fieldLineLengths)
+{
+    const int pointCount = votes.size();
+#ifndef CCTAG_SERIALIZE
+    tbb::parallel_for(0, pointCount, [&](int iEdgePoint) {
+#else
+    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint ) {
+#endif
+        EdgePoint* choosen = fieldLineWinner<NCrowns>(edgeCollection, *edgeCollection(iEdgePoint), params, fieldLineLengths[iEdgePoint]);
+        votes[iEdgePoint] = edgeCollection(choosen);
+#ifndef CCTAG_SERIALIZE
+    });
+#else
+    }
+#endif
+}
+
 /* Brief: Voting procedure. For every edge points, construct the 1st order approximation 
  * of the field line passing through it which consists in a polygonal line whose
  * extremities are two edge points.
@@ -67,10 +158,13 @@ void vote(EdgePointCollection& edgeCollection,
 #endif
   
   const int pointCount = edgeCollection.get_point_count();
-  std::vector<std::vector<int>> voters;
-  voters.resize(pointCount);
 
+    // Every edge point only writes its own links, the edge points are processed in parallel.
+#ifndef CCTAG_SERIALIZE
+    tbb::parallel_for(0, pointCount, [&](int iEdgePoint) {
+#else
     for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint ) {
+#endif
         EdgePoint& p = *edgeCollection(iEdgePoint);
         EdgePoint* link;
         int ilink;
@@ -79,14 +173,18 @@ void vote(EdgePointCollection& edgeCollection,
         ilink = edgeCollection(link);
         edgeCollection.set_before(&p, ilink);
         
-        CCTagFileDebug::instance().endVote();
+        CCTAG_VOTE_DEBUG_CALL(endVote());
         
         link = gradientDirectionDescent(edgeCollection, p, 1, params._distSearch, dx, dy, params._thrGradientMagInVote);
         ilink = edgeCollection(link);
         edgeCollection.set_after(&p, ilink);
         
-        CCTagFileDebug::instance().endVote();
+        CCTAG_VOTE_DEBUG_CALL(endVote());
+#ifndef CCTAG_SERIALIZE
+    });
+#else
     }
+#endif
     // Vote
     seeds.reserve(pointCount / 2);
 
@@ -96,155 +194,108 @@ void vote(EdgePointCollection& edgeCollection,
 		throw std::domain_error("thrVotingAngle must be equal to 0 or edge points gradients have to be normalized.");
     }
 
-    
-    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint )
-    {
-        EdgePoint& p = *edgeCollection(iEdgePoint);
-        
-        // Alternate from the edge point found in the direction opposed to the gradient
-        // direction.
-        EdgePoint* current = edgeCollection.before(&p);
-        // Here current contains the edge point lying on the 2nd ellipse (from outer to inner)
-        EdgePoint* choosen = nullptr;
-
-        // To save all sub-segments length
-        std::vector<float> vDist; ///
-        vDist.reserve(params._nCrowns * 2 - 1);
-
-        // Length of the reconstructed field line approximation between the two
-        // extremities.
-        float totalDistance = 0.f;
-
-        if (current != nullptr)
-        {
-            // difference in subsequent gradients orientation
-            float cosDiffTheta = -p.gradient().dot(current->gradient());
-            if (cosDiffTheta >= params._angleVoting)
-            {
-                float lastDist = cctag::numerical::distancePoints2D(p, *current);
-                vDist.push_back(lastDist);
-                
-                // Add the sub-segment length to the total distance.
-                totalDistance += lastDist;
+    // Index of the edge point every edge point votes for (or -1), and the length of the
+    // field line it followed.
+    std::vector<int> votes(pointCount);
+    std::vector<float> fieldLineLengths(pointCount);
 
-                std::size_t i = 1;
-                // Iterate over all crowns
-                while (i < params._nCrowns)
-                {
-                    choosen = nullptr;
-                    
-                    // First in the gradient direction
-                    EdgePoint* target = edgeCollection.after(current);
-                    // No edge point was found in that direction
-                    if (target == nullptr)
-                    {
-                        break;
-                    }
-                    
-                    // Check the difference of two consecutive angles
-                    cosDiffTheta = -target->gradient().dot(current->gradient());
-                    if (cosDiffTheta >= params._angleVoting)
-                    {
-                        // scalar used to compute the distance ratio
-                        float dist = cctag::numerical::distancePoints2D(*target, *current);
-                        vDist.push_back(dist);
-                        totalDistance += dist;
-
-                        int flagDist = 1;
+    switch (params._nCrowns)
+    {
+        case 3:
+            followFieldLines<3>(edgeCollection, params, votes, fieldLineLengths);
+            break;
+        case 4:
+            followFieldLines<4>(edgeCollection, params, votes, fieldLineLengths);
+            break;
+        default:
+            followFieldLines<0>(edgeCollection, params, votes, fieldLineLengths);
+            break;
+    }
+    edgeCollection.create_voter_lists(votes);
 
-                        // Check the distance ratio
-                        if (vDist.size() > 1)
-                        {
-                            for (int iDist = 0; iDist < vDist.size(); ++iDist)
-                            {
-                                for (int jDist = iDist + 1; jDist < vDist.size(); ++jDist)
-                                {
-                                    flagDist = (vDist[iDist] <= vDist[jDist] * params._ratioVoting) && (vDist[jDist] <= vDist[iDist] * params._ratioVoting) && flagDist;
-                                }
-                            }
-                        }
+    // Every edge point now reads its sorted voters: the flow length average scale factor is
+    // accumulated in the voting order, and an edge point with enough votes becomes a seed.
+    // The seeds are kept in the order in which they received their deciding vote.
+    const std::size_t minVotes = std::max(params._minVotesToSelectCandidate, std::size_t(1));
+    std::vector<int> seedVoter(pointCount, -1);
 
-                        if (flagDist != 0)
-                        {
-                            lastDist = dist;
-                            current = target;
-                            // Second in the opposite gradient direction
-                            target = edgeCollection.before(current);
-                            if (target == nullptr)
-                            {
-                                break;
-                            }
-                            cosDiffTheta = -target->gradient().dot(current->gradient());
-                            if (cosDiffTheta >= params._angleVoting)
-                            {
-                                dist = cctag::numerical::distancePoints2D(*target, *current);
-                                vDist.push_back(dist);
-                                totalDistance += dist;
-
-                                for (int iDist = 0; iDist < vDist.size(); ++iDist)
-                                {
-                                    for (int jDist = iDist + 1; jDist < vDist.size(); ++jDist)
-                                    {
-                                        flagDist = (vDist[iDist] <= vDist[jDist] * params._ratioVoting) && (vDist[jDist] <= vDist[iDist] * params._ratioVoting) && flagDist;
-                                    }
-                                }
+#ifndef CCTAG_SERIALIZE
+    tbb::parallel_for(0, pointCount, [&](int iEdgePoint) {
+#else
+    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint ) {
+#endif
+        EdgePoint* choosen = edgeCollection(iEdgePoint);
+        const auto voters = edgeCollection.voters(choosen);
+        const std::size_t nVoters = voters.second - voters.first;
 
-                                if (flagDist)
-                                {
-                                    lastDist = dist;
-                                    current = target;
-                                    choosen = current;
-                                    if (current == nullptr)
-                                    {
-                                        break;
-                                    }
-                                }
-                                else
-                                {
-                                    break;
-                                }
-                            }
-                            else
-                            {
-                                break;
-                            }
-                        }
-                        else
-                        {
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        break;
-                    }
-                    ++i;
-                } // while
-            }
-        }
-        // Check if winner was found
-        if (choosen != nullptr)
+        for (std::size_t iVoter = 1; iVoter <= nVoters; ++iVoter)
         {
-            int iChoosen = edgeCollection(choosen);
-            voters[iChoosen].push_back(edgeCollection(&p));
             // update flow length average scale factor
-            choosen->_flowLength = (choosen->_flowLength * (voters[iChoosen].size() - 1) + totalDistance) / voters[iChoosen].size();
+            choosen->_flowLength = (choosen->_flowLength * (iVoter - 1) + fieldLineLengths[voters.first[iVoter - 1]]) / iVoter;
+        }
 
-            // If choosen has a number of votes greater than one of
-            // the edge points, then update max.
-            if (voters[iChoosen].size() >= params._minVotesToSelectCandidate) {
-                if (choosen->_isMax == -1) {
-                    seeds.push_back(choosen);
-                }
-                choosen->_isMax = voters[iChoosen].size();
+        // If choosen has a number of votes greater than one of
+        // the edge points, then update max.
+        if (nVoters >= minVotes) {
+            if (choosen->_isMax == -1) {
+                seedVoter[iEdgePoint] = voters.first[minVotes - 1];
             }
+            choosen->_isMax = nVoters;
         }
+#ifndef CCTAG_SERIALIZE
+    });
+#else
+    }
+#endif
+
+    std::vector<std::pair<int, EdgePoint*>> newSeeds;
+    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint )
+    {
+        if (seedVoter[iEdgePoint] >= 0)
+            newSeeds.emplace_back(seedVoter[iEdgePoint], edgeCollection(iEdgePoint));
     }
-    edgeCollection.create_voter_lists(voters);
+    std::sort(newSeeds.begin(), newSeeds.end());
+    for (const auto& seed : newSeeds)
+        seeds.push_back(seed.second);
     
     CCTAG_COUT_LILIAN("Elapsed time for vote: " << t.elapsed());
 }
 
+std::vector<EdgePoint*> selectSeeds(const std::vector<EdgePoint*>& seeds, std::size_t nSeeds)
+{
+    nSeeds = std::min(nSeeds, seeds.size());
+
+    std::vector<EdgePoint*> selected;
+    if (nSeeds == 0)
+        return selected;
+
+    // Number of votes of the last selected seed
+    std::vector<int> votes(seeds.size());
+    std::transform(seeds.begin(), seeds.end(), votes.begin(), [](const EdgePoint* p) { return p->_isMax; });
+    std::nth_element(votes.begin(), votes.begin() + (nSeeds - 1), votes.end(), std::greater<int>());
+    const int lastVotes = votes[nSeeds - 1];
+
+    // All the seeds with more votes are selected, then the first ones with as many
+    std::size_t nTies = nSeeds - std::count_if(votes.begin(), votes.begin() + nSeeds,
+                                               [lastVotes](int v) { return v > lastVotes; });
+    selected.reserve(nSeeds);
+    for (EdgePoint* p : seeds)
+    {
+        if (p->_isMax > lastVotes)
+        {
+            selected.push_back(p);
+        }
+        else if (p->_isMax == lastVotes && nTies > 0)
+        {
+            selected.push_back(p);
+            --nTies;
+        }
+    }
+
+    std::stable_sort(selected.begin(), selected.end(), receivedMoreVoteThan);
+    return selected;
+}
+
     static inline unsigned packxy(int x, int y)
     {
       unsigned ux = x, uy = y;
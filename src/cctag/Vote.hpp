@@ -41,6 +41,14 @@ void vote(EdgePointCollection& edgeCollection, std::vector<EdgePoint*> & seeds,
         const cv::Mat & dy,
         const Parameters & params);
  
+/** @brief Select the seeds having received the most votes.
+ * @param seeds vote winners, as output by vote()
+ * @param nSeeds maximum number of seeds to select
+ * @return the selected seeds sorted by decreasing number of votes, seeds with the same
+ * number of votes keeping their order in \p seeds.
+ */
+std::vector<EdgePoint*> selectSeeds(const std::vector<EdgePoint*>& seeds, std::size_t nSeeds);
+
 /** @brief Retrieve all connected edges.
  * @param[out] convexEdgeSegment
  */
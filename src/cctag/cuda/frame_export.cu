@@ -61,6 +61,8 @@ bool Frame::applyExport( cctag::EdgePointCollection& out_edges,
                v_comp );
 #endif // SORT_ALL_EDGECOORDS_IN_EXPORT
 
+    out_edges.reserve( min(all_sz,max_edge_pt) );
+
     for(int i = 0; i < min(all_sz,max_edge_pt); ++i) {
           const short2& pt = _all_edgecoords.host.ptr[i];
           const int16_t dx = _h_dx.ptr(pt.y)[pt.x];
@@ -15,11 +15,14 @@
 #include <opencv2/opencv.hpp>
 
 #include "cctag/filter/cvRecode.hpp"
+#include "cctag/filter/derivatives.hpp"
 #include "cctag/Params.hpp"
 #include "cctag/utils/Talk.hpp" // do DO_TALK macro
 
 #include <boost/timer/timer.hpp>
 
+#include <tbb/tbb.h>
+
 #include <cstdlib> // for ::abs
 #include <climits>
 #include <cmath>
@@ -35,6 +38,301 @@
 
 // #define DEBUG_MAGMAP_BY_GRIFF
 #define USE_INTEGER_REP
+// #define USE_FILTER2D_DERIVATIVES // reference 2D implementation of gaussianDerivatives
+
+#define CANNY_SHIFT 15
+#define TG22 (int)(0.4142135623730950488016887242097 * (1 << CANNY_SHIFT) + 0.5)
+
+namespace {
+
+// Number of image rows processed end-to-end by one task: the buffers of a stripe of a 4K
+// image stay within L2.
+constexpr int kCannyStripeRows = 32;
+
+struct CannyStripeBuffers
+{
+    cv::Mat dx;           // derivatives of the stripe rows, and of the rows just above and below
+    cv::Mat dy;
+    std::vector<int> mag; // magnitude of the same rows, with a zero border
+};
+
+/* Fused pass on the image rows [rowBegin, rowEnd): derivatives (written to imgDX and imgDY),
+ * magnitude and non-maxima suppression. The map rows of the stripe are filled with
+ *   0 - the pixel might belong to an edge
+ *   1 - the pixel can not belong to an edge
+ *   2 - the pixel does belong to an edge
+ * and the pixels set to 2 are appended to seeds for the hysteresis.
+ *
+ * A strong pixel next to an already seeded one (on its left or above) is only marked 0 since
+ * the hysteresis reaches it anyway. The row above a stripe belongs to another task, so that
+ * shortcut is not taken on the first row of a stripe, which does not change the edges.
+ */
+void cannyStripe(const cv::Mat& imgGraySrc,
+                 cv::Mat& imgDX,
+                 cv::Mat& imgDY,
+                 int rowBegin,
+                 int rowEnd,
+                 int flags,
+                 int low,
+                 int high,
+                 uchar* map,
+                 ptrdiff_t mapstep,
+                 CannyStripeBuffers& buffers,
+                 std::vector<uchar*>& seeds)
+{
+    const int width = imgGraySrc.cols;
+    const int height = imgGraySrc.rows;
+
+    // Rows with derivatives: the stripe and its neighbours inside the image.
+    const int bandBegin = std::max(rowBegin - 1, 0);
+    const int bandEnd = std::min(rowEnd + 1, height);
+
+    buffers.dx.create(rowEnd - rowBegin + 2, width, CV_16SC1);
+    buffers.dy.create(rowEnd - rowBegin + 2, width, CV_16SC1);
+
+#ifdef USE_FILTER2D_DERIVATIVES
+    for(int y = bandBegin; y < bandEnd; y++)
+    {
+        memcpy(buffers.dx.ptr<short>(y - bandBegin), imgDX.ptr<short>(y), width * sizeof(short));
+        memcpy(buffers.dy.ptr<short>(y - bandBegin), imgDY.ptr<short>(y), width * sizeof(short));
+    }
+#else
+    cctag::gaussianDerivatives(imgGraySrc, buffers.dx, buffers.dy, bandBegin, bandEnd, 0);
+    for(int y = rowBegin; y < rowEnd; y++)
+    {
+        memcpy(imgDX.ptr<short>(y), buffers.dx.ptr<short>(y - bandBegin), width * sizeof(short));
+        memcpy(imgDY.ptr<short>(y), buffers.dy.ptr<short>(y - bandBegin), width * sizeof(short));
+    }
+#endif // USE_FILTER2D_DERIVATIVES
+
+    // Magnitude of the rows rowBegin-1 .. rowEnd, the ones outside of the image staying at 0.
+    const ptrdiff_t magstep = width + 2;
+    buffers.mag.assign((rowEnd - rowBegin + 2) * magstep, 0);
+
+    for(int y = bandBegin; y < bandEnd; y++)
+    {
+        int* _mag = &buffers.mag[(y - rowBegin + 1) * magstep + 1];
+        const short* _imgDX = buffers.dx.ptr<short>(y - bandBegin);
+        const short* _imgDY = buffers.dy.ptr<short>(y - bandBegin);
+
+        if(!(flags & CV_CANNY_L2_GRADIENT))
+        {
+            // Using Manhattan distance
+            for(int j = 0; j < width; j++)
+                _mag[j] = abs(_imgDX[j]) + abs(_imgDY[j]);
+        }
+        else
+        {
+            // Using Euclidian distance
+            for(int j = 0; j < width; j++)
+            {
+                const int x = _imgDX[j];
+                const int y = _imgDY[j];
+#ifdef USE_INTEGER_REP
+                _mag[j] = (int)rintf((float)std::sqrt((float)x * x + (float)y * y));
+#else
+                auto* _magf = (float*)_mag;
+                _magf[j] = (float)std::sqrt((float)x * x + (float)y * y);
+#endif
+            }
+        }
+    }
+
+    // Non-maxima suppression, the magnitudes above and below are one magstep away.
+    const ptrdiff_t magstep1 = magstep;
+    const ptrdiff_t magstep2 = -magstep;
+
+    for(int i = rowBegin; i < rowEnd; i++)
+    {
+        const int* _mag = &buffers.mag[(i - rowBegin + 1) * magstep + 1];
+        const short* _imgDX = buffers.dx.ptr<short>(i - bandBegin);
+        const short* _imgDY = buffers.dy.ptr<short>(i - bandBegin);
+
+        uchar* _map = map + mapstep * (i + 1) + 1;
+        _map[-1] = _map[width] = 1;
+
+        const bool ownRowAbove = i > rowBegin;
+        int prev_flag = 0;
+
+        for(int j = 0; j < width; j++)
+        {
+            int x = _imgDX[j];
+            int y = _imgDY[j];
+            int s = x ^ y;
+            int m = _mag[j];
+
+            x = abs(x);
+            y = abs(y);
+            if(m > low)
+            {
+                int tg22x = x * TG22;
+                int tg67x = tg22x + ((x + x) << CANNY_SHIFT);
+
+                y <<= CANNY_SHIFT;
+
+                bool isMax;
+                if(y < tg22x)
+                {
+                    isMax = m > _mag[j - 1] && m >= _mag[j + 1];
+                }
+                else if(y > tg67x)
+                {
+                    isMax = m > _mag[j + magstep2] && m >= _mag[j + magstep1];
+                }
+                else
+                {
+                    s = s < 0 ? -1 : 1;
+                    isMax = m > _mag[j + magstep2 - s] && m > _mag[j + magstep1 + s];
+                }
+
+                if(isMax)
+                {
+                    if(m > high && !prev_flag && !(ownRowAbove && _map[j - mapstep] == 2))
+                    {
+                        _map[j] = (uchar)2;
+                        seeds.push_back(_map + j);
+                        prev_flag = 1;
+                    }
+                    else
+                        _map[j] = (uchar)0;
+                    continue;
+                }
+            }
+            prev_flag = 0;
+            _map[j] = (uchar)1;
+        }
+    }
+}
+
+/* Hysteresis as a connected-component labelling of the map: an edge is an 8-connected
+ * component of the pixels that might belong to an edge (0) or do (2) which holds at least
+ * one pixel that does, which is what the edge tracking from the seeds produces as well.
+ *
+ * Every stripe is labelled on its own with a union-find whose roots are the smallest pixel
+ * index of their component, the components are then merged across the stripe borders and
+ * imgCanny is written from the flag of the roots.
+ */
+class CannyLabelling
+{
+public:
+    // Every node is initialized when its pixel is labelled: the buffers are only grown.
+    CannyLabelling(const uchar* map, ptrdiff_t mapstep, int width, int height, cctag::CannyBuffers& buffers)
+      : _map(map)
+      , _mapstep(mapstep)
+      , _width(width)
+      , _parent(buffers.parent)
+      , _strong(buffers.strong)
+    {
+        const std::size_t nPixels = (std::size_t)width * height;
+        if(_parent.size() < nPixels)
+        {
+            _parent.resize(nPixels);
+            _strong.resize(nPixels);
+        }
+    }
+
+    void labelStripe(int rowBegin, int rowEnd)
+    {
+        for(int y = rowBegin; y < rowEnd; y++)
+        {
+            const uchar* m = mapRow(y);
+            for(int x = 0; x < _width; x++)
+            {
+                if(m[x] == 1)
+                    continue;
+                const int p = y * _width + x;
+                _parent[p] = p;
+                _strong[p] = m[x] == 2;
+                if(m[x - 1] != 1)
+                    merge(p, p - 1);
+                if(y > rowBegin)
+                    mergeAbove(m, x, p);
+            }
+        }
+        // roots precede their pixels, one raster pass flattens the trees
+        for(int y = rowBegin; y < rowEnd; y++)
+        {
+            const uchar* m = mapRow(y);
+            int* parent = &_parent[y * _width];
+            for(int x = 0; x < _width; x++)
+                if(m[x] != 1)
+                    parent[x] = _parent[parent[x]];
+        }
+    }
+
+    void mergeStripeBorder(int row)
+    {
+        const uchar* m = mapRow(row);
+        for(int x = 0; x < _width; x++)
+            if(m[x] != 1)
+                mergeAbove(m, x, row * _width + x);
+    }
+
+    void writeEdges(int rowBegin, int rowEnd, cv::Mat& imgCanny) const
+    {
+        for(int y = rowBegin; y < rowEnd; y++)
+        {
+            const uchar* m = mapRow(y);
+            auto* _imgCanny = imgCanny.ptr<uchar>(y);
+            for(int x = 0; x < _width; x++)
+            {
+                uchar v = 0;
+                if(m[x] != 1)
+                {
+                    int r = _parent[y * _width + x];
+                    while(_parent[r] != r)
+                        r = _parent[r];
+                    v = (uchar) - _strong[r];
+                }
+                _imgCanny[x] = v;
+            }
+        }
+    }
+
+private:
+    const uchar* mapRow(int y) const { return _map + _mapstep * (y + 1) + 1; }
+
+    void mergeAbove(const uchar* m, int x, int p)
+    {
+        const uchar* above = m - _mapstep;
+        if(above[x - 1] != 1)
+            merge(p, p - _width - 1);
+        if(above[x] != 1)
+            merge(p, p - _width);
+        if(above[x + 1] != 1)
+            merge(p, p - _width + 1);
+    }
+
+    int find(int p)
+    {
+        while(_parent[p] != p)
+        {
+            _parent[p] = _parent[_parent[p]];
+            p = _parent[p];
+        }
+        return p;
+    }
+
+    void merge(int p, int q)
+    {
+        int rp = find(p);
+        int rq = find(q);
+        if(rp == rq)
+            return;
+        if(rp < rq)
+            std::swap(rp, rq);
+        _parent[rp] = rq;
+        _strong[rq] |= _strong[rp];
+    }
+
+    const uchar* _map;
+    const ptrdiff_t _mapstep;
+    const int _width;
+    std::vector<int>& _parent;
+    std::vector<uchar>& _strong;
+};
+
+}
 
 void cvRecodedCanny(const cv::Mat& imgGraySrc,
                     cv::Mat& imgCanny,
@@ -44,7 +342,8 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
                     float high_thresh,
                     int aperture_size,
                     int debug_info_level,
-                    const cctag::Parameters* params)
+                    const cctag::Parameters* params,
+                    cctag::CannyBuffers* buffers)
 {
     boost::timer::cpu_timer t;
     std::vector<uchar*> stack;
@@ -70,6 +369,7 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
     if((aperture_size & 1) == 0 || aperture_size < 3 || aperture_size > 7)
         CV_Error(CV_StsBadFlag, "");
 
+#ifdef USE_FILTER2D_DERIVATIVES
     // Apply the (9x9) 2D following kernel for the derivatives in x and y direction
     const cv::Mat kerneldX = (cv::Mat_<float>(9,9) <<
     -0.000000143284235f, -0.000003558691641f, -0.000028902492951f, -0.000064765993382f, 0.f, 0.000064765993382f, 0.000028902492951f, 0.000003558691641f, 0.000000143284235f,
@@ -90,6 +390,11 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
 
     cv::filter2D(imgGraySrc, imgDX, CV_16SC1, kerneldX, anchor, delta, cv::BORDER_REPLICATE);
     cv::filter2D(imgGraySrc, imgDY, CV_16SC1, kerneldY, anchor, delta, cv::BORDER_REPLICATE);
+#else
+    // Same kernel, applied as separable passes within the stripes below
+    imgDX.create(size, CV_16SC1);
+    imgDY.create(size, CV_16SC1);
+#endif // USE_FILTER2D_DERIVATIVES
 
 #ifndef USE_INTEGER_REP
     if(flags & CV_CANNY_L2_GRADIENT)
@@ -140,22 +445,13 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
 #endif // CCTAG_WITH_CUDA
 #endif // DEBUG_MAGMAP_BY_GRIFF
 
-    cv::AutoBuffer<char> buffer;
-    //               (             mag_buf                )   (                 map                  )
-    buffer.allocate((size.width + 2) * 3 * sizeof(int) + (size.width + 2) * (size.height + 2));
+    cv::AutoBuffer<uchar> buffer;
+    //               (                 map                  )
+    buffer.allocate((size.width + 2) * (size.height + 2));
 
-    int* mag_buf[3];
-    mag_buf[0] = (int*)(char*)buffer;
-    mag_buf[1] = mag_buf[0] + size.width + 2;
-    mag_buf[2] = mag_buf[1] + size.width + 2;
-    map = (uchar*)(mag_buf[2] + size.width + 2);
+    map = (uchar*)buffer;
     mapstep = size.width + 2;
 
-    maxsize = MAX(1 << 10, size.width * size.height / 10);
-    stack.resize(maxsize);
-    stack_top = stack_bottom = &stack[0];
-
-    memset(mag_buf[0], 0, (size.width + 2) * sizeof(int));
     memset(map, 1, mapstep);
     memset(map + mapstep * (size.height + 1), 1, mapstep);
 
@@ -166,168 +462,64 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
     DO_TALK(CCTAG_COUT_DEBUG("Canny 1 took: " << t.elapsed()););
     t.resume();
 
-    // calculate magnitude and angle of gradient, perform non-maxima suppression.
-    // fill the map with one of the following values:
-    //   0 - the pixel might belong to an edge
-    //   1 - the pixel can not belong to an edge
-    //   2 - the pixel does belong to an edge
-    for(i = 0; i <= size.height; i++)
-    {
-        int* _mag = mag_buf[(i > 0) + 1] + 1;
+    // calculate magnitude and angle of gradient, perform non-maxima suppression,
+    // stripe by stripe.
+    const int nStripes = (size.height + kCannyStripeRows - 1) / kCannyStripeRows;
+    std::vector<std::vector<uchar*>> stripeSeeds(nStripes);
+    tbb::enumerable_thread_specific<CannyStripeBuffers> stripeBuffers;
 
-        uchar* _map;
-        int x, y;
-        ptrdiff_t magstep1, magstep2;
-        int prev_flag = 0;
-
-        if(i < size.height)
-        {
-            const short* _imgDX = imgDX.ptr<short>(i);
-            const short* _imgDY = imgDY.ptr<short>(i);
+#ifndef CCTAG_SERIALIZE
+    tbb::parallel_for(0, nStripes, [&](int iStripe) {
+#else
+    for(int iStripe = 0; iStripe < nStripes; ++iStripe)
+    {
+#endif
+        const int rowBegin = iStripe * kCannyStripeRows;
+        const int rowEnd = std::min(rowBegin + kCannyStripeRows, size.height);
+        cannyStripe(imgGraySrc, imgDX, imgDY, rowBegin, rowEnd, flags, low, high,
+                    map, mapstep, stripeBuffers.local(), stripeSeeds[iStripe]);
+#ifndef CCTAG_SERIALIZE
+    });
+#else
+    }
+#endif
 
-            _mag[-1] = _mag[size.width] = 0;
+    const bool parallelHysteresis = params && params->_parallelHysteresis;
 
-            if(!(flags & CV_CANNY_L2_GRADIENT))
-            {
-                // Using Manhattan distance
-                for(j = 0; j < size.width; j++)
-                    _mag[j] = abs(_imgDX[j]) + abs(_imgDY[j]);
-            }
-            else
-            {
-                // Using Euclidian distance
+    // gather the seeds in the stripe order
+    std::size_t nSeeds = 0;
+    for(const auto& seeds : stripeSeeds)
+        nSeeds += seeds.size();
 
-                for(j = 0; j < size.width; j++)
-                {
-                    auto* _magf = (float*)_mag;
-                    x = _imgDX[j];
-                    y = _imgDY[j];
-#ifdef USE_INTEGER_REP
-                    _mag[j] = (int)rintf((float)std::sqrt((float)x * x + (float)y * y));
-#else
-                    _magf[j] = (float)std::sqrt((float)x * x + (float)y * y);
-#endif
-                    CCTAG_IF_DEBUG(if(_imgDX[j] > 200) { CCTAG_COUT_NOENDL(_imgDX[j] << ", " << _imgDY[j] << ", "); })
-                }
-            }
-        }
-        else
-            memset(_mag - 1, 0, (size.width + 2) * sizeof(int));
+    maxsize = MAX(MAX(1 << 10, size.width * size.height / 10), (int)nSeeds + 8);
+    if(!parallelHysteresis)
+    {
+        stack.resize(maxsize);
+        stack_top = stack_bottom = &stack[0];
+        for(const auto& seeds : stripeSeeds)
+            stack_top = std::copy(seeds.begin(), seeds.end(), stack_top);
+    }
 
 #ifdef DEBUG_MAGMAP_BY_GRIFF
-        if(mag_img_file)
+    if(mag_img_file)
+    {
+        for(i = 0; i < size.height; i++)
         {
-            if(i > 0)
+            const short* _imgDX = imgDX.ptr<short>(i);
+            const short* _imgDY = imgDY.ptr<short>(i);
+            for(j = 0; j < size.width; j++)
             {
-                for(int j = 0; j < size.width; j++)
-                {
+                const float x = _imgDX[j];
+                const float y = _imgDY[j];
 #ifdef USE_INTEGER_REP
-                    mag_collect.push_back(_mag[j]);
+                mag_collect.push_back((int)rintf(std::sqrt(x * x + y * y)));
 #else  // USE_INTEGER_REP
-                    mag_collect.push_back(float(_mag[j]));
+                mag_collect.push_back(std::sqrt(x * x + y * y));
 #endif // USE_INTEGER_REP
-                }
-            }
-        }
-#endif // DEBUG_MAGMAP_BY_GRIFF
-
-        // at the very beginning we do not have a complete ring
-        // buffer of 3 magnitude rows for non-maxima suppression
-        if(i == 0)
-            continue;
-
-        _map = map + mapstep * i + 1;
-        _map[-1] = _map[size.width] = 1;
-
-        _mag = mag_buf[1] + 1; // take the central row
-        const short* _imgDX = imgDX.ptr<short>(i - 1);
-        const short* _imgDY = imgDY.ptr<short>(i - 1);
-
-        magstep1 = mag_buf[2] - mag_buf[1];
-        magstep2 = mag_buf[0] - mag_buf[1];
-
-        if((stack_top - stack_bottom) + size.width > maxsize)
-        {
-            int sz = (int)(stack_top - stack_bottom);
-            maxsize = MAX(maxsize * 3 / 2, maxsize + 8);
-            stack.resize(maxsize);
-            stack_bottom = &stack[0];
-            stack_top = stack_bottom + sz;
-        }
-
-        for(j = 0; j < size.width; j++)
-        {
-#define CANNY_SHIFT 15
-#define TG22 (int)(0.4142135623730950488016887242097 * (1 << CANNY_SHIFT) + 0.5)
-
-            x = _imgDX[j];
-            y = _imgDY[j];
-            int s = x ^ y;
-            int m = _mag[j];
-
-            x = abs(x);
-            y = abs(y);
-            if(m > low)
-            {
-                int tg22x = x * TG22;
-                int tg67x = tg22x + ((x + x) << CANNY_SHIFT);
-
-                y <<= CANNY_SHIFT;
-
-                if(y < tg22x)
-                {
-                    if(m > _mag[j - 1] && m >= _mag[j + 1])
-                    {
-                        if(m > high && !prev_flag && _map[j - mapstep] != 2)
-                        {
-                            CANNY_PUSH(_map + j);
-                            prev_flag = 1;
-                        }
-                        else
-                            _map[j] = (uchar)0;
-                        continue;
-                    }
-                }
-                else if(y > tg67x)
-                {
-                    if(m > _mag[j + magstep2] && m >= _mag[j + magstep1])
-                    {
-                        if(m > high && !prev_flag && _map[j - mapstep] != 2)
-                        {
-                            CANNY_PUSH(_map + j);
-                            prev_flag = 1;
-                        }
-                        else
-                            _map[j] = (uchar)0;
-                        continue;
-                    }
-                }
-                else
-                {
-                    s = s < 0 ? -1 : 1;
-                    if(m > _mag[j + magstep2 - s] && m > _mag[j + magstep1 + s])
-                    {
-                        if(m > high && !prev_flag && _map[j - mapstep] != 2)
-                        {
-                            CANNY_PUSH(_map + j);
-                            prev_flag = 1;
-                        }
-                        else
-                            _map[j] = (uchar)0;
-                        continue;
-                    }
-                }
             }
-            prev_flag = 0;
-            _map[j] = (uchar)1;
         }
-
-        // scroll the ring buffer
-        _mag = mag_buf[0];
-        mag_buf[0] = mag_buf[1];
-        mag_buf[1] = mag_buf[2];
-        mag_buf[2] = _mag;
     }
+#endif // DEBUG_MAGMAP_BY_GRIFF
 
     t.stop();
     DO_TALK(CCTAG_COUT_DEBUG("Canny 2 took : " << t.elapsed());)
@@ -360,6 +552,58 @@ void cvRecodedCanny(const cv::Mat& imgGraySrc,
 #endif // DEBUG_MAGMAP_BY_GRIFF
     t.resume();
 
+    if(parallelHysteresis)
+    {
+        // label the edges stripe by stripe, then join the labels across the stripe borders
+        cctag::CannyBuffers localBuffers;
+        CannyLabelling labelling(map, mapstep, size.width, size.height, buffers ? *buffers : localBuffers);
+
+#ifndef CCTAG_SERIALIZE
+        tbb::parallel_for(0, nStripes, [&](int iStripe) {
+#else
+        for(int iStripe = 0; iStripe < nStripes; ++iStripe)
+        {
+#endif
+            const int rowBegin = iStripe * kCannyStripeRows;
+            labelling.labelStripe(rowBegin, std::min(rowBegin + kCannyStripeRows, size.height));
+#ifndef CCTAG_SERIALIZE
+        });
+#else
+        }
+#endif
+
+        for(int iStripe = 1; iStripe < nStripes; ++iStripe)
+            labelling.mergeStripeBorder(iStripe * kCannyStripeRows);
+
+        t.stop();
+        DO_TALK(CCTAG_COUT_DEBUG("Canny 3 took : " << t.elapsed());)
+        t.resume();
+
+#ifndef CCTAG_SERIALIZE
+        tbb::parallel_for(0, nStripes, [&](int iStripe) {
+#else
+        for(int iStripe = 0; iStripe < nStripes; ++iStripe)
+        {
+#endif
+            const int rowBegin = iStripe * kCannyStripeRows;
+            labelling.writeEdges(rowBegin, std::min(rowBegin + kCannyStripeRows, size.height), imgCanny);
+#ifndef CCTAG_SERIALIZE
+        });
+#else
+        }
+#endif
+
+#ifdef DEBUG_MAGMAP_BY_GRIFF
+        if(hyst_img_file)
+            for(i = 0; i < size.height; i++)
+                hyst_img_file->write((const char*)imgCanny.ptr<uchar>(i), size.width);
+        delete mag_img_file;
+        delete hyst_img_file;
+#endif // DEBUG_MAGMAP_BY_GRIFF
+        DO_TALK(CCTAG_COUT_DEBUG("Canny 4 : " << t.elapsed());)
+        return;
+    }
+
     // now track the edges (hysteresis thresholding)
     while(stack_top > stack_bottom)
     {
@@ -10,8 +10,20 @@
 
 #include <opencv2/core/core.hpp>
 
+#include <vector>
+
 namespace cctag {
 struct Parameters;
+
+/**
+ * @brief Buffers of cvRecodedCanny, kept by the caller so that the calls on images of the same
+ * size do not allocate them again.
+ */
+struct CannyBuffers
+{
+  std::vector<int> parent;   // union-find forest of the parallel hysteresis, one node per pixel
+  std::vector<uchar> strong; // whether the component of a root holds a strong edge pixel
+};
 };
 
 void cvRecodedCanny(
@@ -23,6 +35,7 @@ void cvRecodedCanny(
   float high_thresh,
   int aperture_size,
   int debug_info_level,
-  const cctag::Parameters* params );
+  const cctag::Parameters* params,
+  cctag::CannyBuffers* buffers = nullptr );
 #endif
 
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/filter/derivatives.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace cctag {
+
+namespace {
+
+constexpr int kRadius = 4;
+constexpr int kTaps = 2 * kRadius + 1;
+
+// g(k) = exp(-k^2/2) and d(k) = k exp(-k^2/2) / pi for k = 0..4: the 9x9 kernel of
+// cvRecodedCanny is d(x) g(y) (d(x) is antisymmetric: d(-k) = -d(k)).
+constexpr float kGauss[kRadius + 1] = { 1.f, 0.606530659712633f, 0.135335283236613f, 0.011108996538242f, 0.000335462627903f };
+constexpr float kDeriv[kRadius + 1] = { 0.f, 0.193064705260108f, 0.086157117207395f, 0.010608310271112f, 0.000427124283626f };
+
+/* Horizontal pass on one source row: hGauss = row * g and hDeriv = row * d. padded holds the
+ * row with kRadius replicated pixels on each side.
+ */
+void horizontalPass( const uchar* srcRow, int width, float* padded, float* hGauss, float* hDeriv )
+{
+  for( int x = 0; x < kRadius; ++x )
+  {
+    padded[x] = srcRow[0];
+    padded[kRadius + width + x] = srcRow[width - 1];
+  }
+  for( int x = 0; x < width; ++x )
+    padded[kRadius + x] = srcRow[x];
+
+  const float* c = padded + kRadius;
+  for( int x = 0; x < width; ++x )
+  {
+    hGauss[x] = kGauss[0] * c[x]
+              + kGauss[1] * ( c[x - 1] + c[x + 1] )
+              + kGauss[2] * ( c[x - 2] + c[x + 2] )
+              + kGauss[3] * ( c[x - 3] + c[x + 3] )
+              + kGauss[4] * ( c[x - 4] + c[x + 4] );
+    hDeriv[x] = kDeriv[1] * ( c[x + 1] - c[x - 1] )
+              + kDeriv[2] * ( c[x + 2] - c[x - 2] )
+              + kDeriv[3] * ( c[x + 3] - c[x - 3] )
+              + kDeriv[4] * ( c[x + 4] - c[x - 4] );
+  }
+}
+
+}
+
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy )
+{
+  dx.create( src.rows, src.cols, CV_16SC1 );
+  dy.create( src.rows, src.cols, CV_16SC1 );
+  gaussianDerivatives( src, dx, dy, 0, src.rows );
+}
+
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy, int rowBegin, int rowEnd )
+{
+  gaussianDerivatives( src, dx, dy, rowBegin, rowEnd, rowBegin );
+}
+
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy, int rowBegin, int rowEnd, int dstRow )
+{
+  const int width = src.cols;
+  const int height = src.rows;
+  if( rowBegin >= rowEnd || width == 0 )
+    return;
+
+  // Ring of the horizontal passes of the kTaps source rows around the current output row.
+  std::vector<float> buffer( ( 2 * kTaps + 1 ) * std::size_t( width + 2 * kRadius ) );
+  float* padded = buffer.data();
+  float* hGauss[kTaps];
+  float* hDeriv[kTaps];
+  for( int k = 0; k < kTaps; ++k )
+  {
+    hGauss[k] = padded + ( 1 + k ) * std::size_t( width + 2 * kRadius );
+    hDeriv[k] = padded + ( 1 + kTaps + k ) * std::size_t( width + 2 * kRadius );
+  }
+
+  // Slot of the (virtual, possibly outside of the image) source row v in the ring.
+  const auto slot = [&]( int v ) { return ( ( v % kTaps ) + kTaps ) % kTaps; };
+  const auto load = [&]( int v ) {
+    const int r = std::min( std::max( v, 0 ), height - 1 ); // BORDER_REPLICATE
+    horizontalPass( src.ptr<uchar>( r ), width, padded, hGauss[slot( v )], hDeriv[slot( v )] );
+  };
+
+  for( int v = rowBegin - kRadius; v < rowBegin + kRadius; ++v )
+    load( v );
+
+  for( int y = rowBegin; y < rowEnd; ++y )
+  {
+    load( y + kRadius );
+
+    const float* g[kTaps];
+    const float* d[kTaps];
+    for( int k = 0; k < kTaps; ++k )
+    {
+      g[k] = hGauss[slot( y + k - kRadius )];
+      d[k] = hDeriv[slot( y + k - kRadius )];
+    }
+
+    short* dxRow = dx.ptr<short>( dstRow + y - rowBegin );
+    short* dyRow = dy.ptr<short>( dstRow + y - rowBegin );
+    for( int x = 0; x < width; ++x )
+    {
+      const float vx = kGauss[0] * d[4][x]
+                     + kGauss[1] * ( d[3][x] + d[5][x] )
+                     + kGauss[2] * ( d[2][x] + d[6][x] )
+                     + kGauss[3] * ( d[1][x] + d[7][x] )
+                     + kGauss[4] * ( d[0][x] + d[8][x] );
+      const float vy = kDeriv[1] * ( g[5][x] - g[3][x] )
+                     + kDeriv[2] * ( g[6][x] - g[2][x] )
+                     + kDeriv[3] * ( g[7][x] - g[1][x] )
+                     + kDeriv[4] * ( g[8][x] - g[0][x] );
+      dxRow[x] = cv::saturate_cast<short>( vx );
+      dyRow[x] = cv::saturate_cast<short>( vy );
+    }
+  }
+}
+
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef VISION_CCTAG_DERIVATIVES_HPP_
+#define VISION_CCTAG_DERIVATIVES_HPP_
+
+#include <opencv2/core.hpp>
+
+namespace cctag {
+
+/**
+ * @brief Compute the x and y image derivatives used by the edge detection, i.e. the
+ * correlation of src with the 9x9 derivative of a gaussian (sigma = 1) and its transpose,
+ * with replicated borders.
+ *
+ * The 9x9 kernel is the outer product of a gaussian and of its derivative: it is applied as
+ * a shared horizontal pass (gaussian and derivative rows computed from the same source row)
+ * followed by a vertical pass, i.e. 36 instead of 162 multiply-adds per pixel. Results differ
+ * from cv::filter2D only by the float rounding of the sums (at most 1).
+ *
+ * @param[in] src 8 bits gray scale image.
+ * @param[out] dx CV_16SC1 derivative along x, (re)allocated to the size of src.
+ * @param[out] dy CV_16SC1 derivative along y, (re)allocated to the size of src.
+ */
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy );
+
+/**
+ * @brief Same as above, restricted to the rows [rowBegin, rowEnd) of dx and dy, which must
+ * already be allocated. Rows outside this range are read from src but not written.
+ */
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy, int rowBegin, int rowEnd );
+
+/**
+ * @brief Same as above, the derivatives of the image rows [rowBegin, rowEnd) being written to
+ * the rows starting at dstRow of dx and dy (e.g. dstRow = 0 to fill a band buffer).
+ */
+void gaussianDerivatives( const cv::Mat & src, cv::Mat & dx, cv::Mat & dy, int rowBegin, int rowEnd, int dstRow );
+
+}
+
+#endif
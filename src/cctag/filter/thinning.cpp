@@ -7,6 +7,11 @@
  */
 #include <cctag/filter/thinning.hpp>
 
+#include <tbb/tbb.h>
+
+#include <algorithm>
+#include <vector>
+
 namespace cctag {
 
 static const int lutthin1[512] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 0, 255, 255, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 0, 0, 0, 255, 0, 0, 255, 255, 0, 0, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 };
@@ -18,36 +23,83 @@ void thin( cv::Mat & inout, cv::Mat & temp )
   imageIter( temp, inout, lutthin2 );
 }
 
-void imageIter( const cv::Mat & in, cv::Mat & out, const int* lut )
+namespace {
+
+// Number of rows processed by one task of imageIter.
+constexpr int kThinningBandRows = 32;
+
+/* Apply the LUT to the rows [rowBegin, rowEnd) of the image interior.
+ *
+ * The neighbourhood code of (x,y) is the sum of the codes of the columns x-1, x and x+1
+ * weighted by 1, 8 and 64, the code of a column being
+ *   (in(x,y-1) == 255) + 2 * (in(x,y) == 255) + 4 * (in(x,y+1) == 255).
+ * The column codes are computed for a whole row in a branch-free loop the compiler
+ * vectorizes, and moving to the next row only shifts in the row below.
+ */
+void imageIterRows( const cv::Mat & in, cv::Mat & out, const int* lut, int rowBegin, int rowEnd,
+                    std::vector<uchar> & column )
 {
-  const int width  = in.cols - 1 ;
-  const int height = in.rows - 1 ;
+  const int cols  = in.cols;
+  const int width = in.cols - 1;
+
+  column.resize( cols );
+  uchar* col = column.data();
+
+  {
+    const uchar* ptrInm1 = in.data + ( rowBegin - 1 ) * in.step;
+    const uchar* ptrIn   = in.data + rowBegin * in.step;
+    for( int x = 0; x < cols; ++x )
+      col[x] = ( ptrInm1[x] == 255 ) | ( ( ptrIn[x] == 255 ) << 1 );
+  }
 
-  for( int y = 1; y < height; ++y )
+  for( int y = rowBegin; y < rowEnd; ++y )
   {
-    uchar* ptrInm1 = in.data + ( y - 1 ) * in.step;
-    uchar* ptrIn   = in.data + y * in.step;
-    uchar* ptrInp1 = in.data + ( y + 1 ) * in.step;
+    const uchar* ptrIn   = in.data + y * in.step;
+    const uchar* ptrInp1 = in.data + ( y + 1 ) * in.step;
 
     uchar* ptrOut = out.data + y * out.step;
 
+    for( int x = 0; x < cols; ++x )
+      col[x] = ( col[x] & 3 ) | ( ( ptrInp1[x] == 255 ) << 2 );
+
     for( int x = 1 ; x < width; ++x )
     {
-      if( ptrIn[x] == 0 )
-      {
-              ptrOut[x] = 0;
-      }
-      else
-      {
-        int ind =
-            ( ptrInm1[x - 1] == 255 )     + ( ptrInm1[x] == 255 ) * 8 + ( ptrInm1[x + 1] == 255 )  * 64  +
-            ( ptrIn[x - 1] == 255 )   * 2 + ( ptrIn[x] == 255 )   * 16 + ( ptrIn[x + 1] == 255 )   * 128 +
-            ( ptrInp1[x - 1] == 255 ) * 4 + ( ptrInp1[x] == 255 ) * 32 + ( ptrInp1[x + 1] == 255 ) * 256 ;
-
-        ptrOut[x] = lut[ind];
-      }
+      const int ind = col[x - 1] + col[x] * 8 + col[x + 1] * 64;
+      ptrOut[x] = ptrIn[x] == 0 ? 0 : lut[ind];
     }
+
+    for( int x = 0; x < cols; ++x )
+      col[x] >>= 1;
+  }
+}
+
+}
+
+void imageIter( const cv::Mat & in, cv::Mat & out, const int* lut )
+{
+  // Rows are written to out only from in, so the bands are independent; each band reads
+  // one row of in above and below itself.
+  const int height = in.rows - 1 ;
+  if( height <= 1 )
+    return;
+
+  const int nBands = ( height - 1 + kThinningBandRows - 1 ) / kThinningBandRows;
+  tbb::enumerable_thread_specific<std::vector<uchar>> columns;
+
+#ifndef CCTAG_SERIALIZE
+  tbb::parallel_for( 0, nBands, [&]( int iBand ) {
+#else
+  for( int iBand = 0; iBand < nBands; ++iBand )
+  {
+#endif
+    const int rowBegin = 1 + iBand * kThinningBandRows;
+    const int rowEnd   = std::min( rowBegin + kThinningBandRows, height );
+    imageIterRows( in, out, lut, rowBegin, rowEnd, columns.local() );
+#ifndef CCTAG_SERIALIZE
+  });
+#else
   }
+#endif
 }
 
 }
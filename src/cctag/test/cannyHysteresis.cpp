@@ -0,0 +1,154 @@
+#define BOOST_TEST_MODULE testCannyHysteresis
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/filter/cvRecode.hpp>
+#include <cctag/Params.hpp>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc/types_c.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Random gray image, smoothed over a (2*radius+1)^2 box so that the edges have various
+ * strengths and form connected chains.
+ * @param[in] rows number of rows
+ * @param[in] cols number of columns
+ * @param[in] radius radius of the box filter, 0 for pure noise
+ * @param[in] seed seed of the random generator
+ */
+cv::Mat makeRandomImage(int rows, int cols, int radius, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> uniform(0, 255);
+
+    std::vector<int> noise(std::size_t(rows) * cols);
+    for (int& v : noise)
+        v = uniform(gen);
+
+    cv::Mat img(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            int sum = 0;
+            int n = 0;
+            for (int yy = std::max(y - radius, 0); yy <= std::min(y + radius, rows - 1); ++yy)
+            {
+                for (int xx = std::max(x - radius, 0); xx <= std::min(x + radius, cols - 1); ++xx)
+                {
+                    sum += noise[yy * cols + xx];
+                    ++n;
+                }
+            }
+            img.at<uchar>(y, x) = uchar(sum / n);
+        }
+    }
+    return img;
+}
+
+/**
+ * @brief Concentric rings whose contrast fades around the center, with some noise, so that
+ * the hysteresis has to follow the weak part of the edges from their strong part.
+ * @param[in] rows number of rows
+ * @param[in] cols number of columns
+ * @param[in] seed seed of the random generator
+ */
+cv::Mat makeRingsImage(int rows, int cols, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> noise(-3.f, 3.f);
+
+    const float cx = 0.45f * cols;
+    const float cy = 0.55f * rows;
+    const float ringWidth = 0.06f * std::min(rows, cols) + 2.f;
+
+    cv::Mat img(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; ++y)
+    {
+        for (int x = 0; x < cols; ++x)
+        {
+            const float r = std::hypot(x - cx, y - cy);
+            const float contrast = 10.f + 50.f * (1.f + std::cos(std::atan2(y - cy, x - cx)));
+            const float v = 128.f + ((int(r / ringWidth) % 2) ? contrast : -contrast) + noise(gen);
+            img.at<uchar>(y, x) = uchar(std::min(std::max(v, 0.f), 255.f));
+        }
+    }
+    return img;
+}
+
+/**
+ * @brief Run cvRecodedCanny as Level::extractEdges does.
+ */
+cv::Mat canny(const cv::Mat& src, const cctag::Parameters& params, cctag::CannyBuffers* buffers)
+{
+    cv::Mat edges(src.rows, src.cols, CV_8UC1);
+    cv::Mat dx(src.rows, src.cols, CV_16SC1);
+    cv::Mat dy(src.rows, src.cols, CV_16SC1);
+    cvRecodedCanny(src, edges, dx, dy,
+                   params._cannyThrLow * 256, params._cannyThrHigh * 256,
+                   3 | CV_CANNY_L2_GRADIENT,
+                   0, &params, buffers);
+    return edges;
+}
+
+/**
+ * @brief Check that the edges of the serial edge tracking and of the parallel labelling are
+ * identical, the latter reusing buffers.
+ */
+void checkSameEdges(const cv::Mat& src, cctag::CannyBuffers& buffers)
+{
+    cctag::Parameters params;
+    params._parallelHysteresis = false;
+    const cv::Mat serial = canny(src, params, nullptr);
+    params._parallelHysteresis = true;
+    const cv::Mat parallel = canny(src, params, &buffers);
+
+    std::size_t nEdges = 0;
+    std::size_t nDifferences = 0;
+    for (int y = 0; y < src.rows; ++y)
+    {
+        for (int x = 0; x < src.cols; ++x)
+        {
+            nEdges += serial.at<uchar>(y, x) != 0;
+            nDifferences += serial.at<uchar>(y, x) != parallel.at<uchar>(y, x);
+        }
+    }
+    BOOST_CHECK_EQUAL(nDifferences, 0);
+    BOOST_TEST_MESSAGE(src.rows << "x" << src.cols << ": " << nEdges << " edge pixels");
+}
+
+// Sizes (rows, cols) smaller than, equal to and not a multiple of the 32-row stripes
+const std::vector<std::pair<int, int>> kSizes = {
+    {1, 1}, {5, 7}, {31, 40}, {32, 32}, {33, 17}, {97, 131}, {200, 150}, {321, 257}};
+
+BOOST_AUTO_TEST_SUITE(test_cannyHysteresis)
+
+BOOST_AUTO_TEST_CASE(test_random_images)
+{
+    cctag::CannyBuffers buffers;
+    unsigned seed = 0;
+    for (const auto& size : kSizes)
+    {
+        for (const int radius : {0, 1, 3})
+            checkSameEdges(makeRandomImage(size.first, size.second, radius, ++seed), buffers);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_rings_images)
+{
+    // The buffers are reused from larger images first
+    cctag::CannyBuffers buffers;
+    unsigned seed = 100;
+    for (auto size = kSizes.rbegin(); size != kSizes.rend(); ++size)
+        checkSameEdges(makeRingsImage(size->first, size->second, ++seed), buffers);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,110 @@
+#define BOOST_TEST_MODULE testCostFunctionGlob
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/Identification.hpp>
+#include <cctag/ImageCut.hpp>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Residual as costFunctionGlob used to compute it: the average over all the
+ * readable cut-pairs of the sum of the squared differences of their signals.
+ */
+float pairwiseResidual(const std::vector<cctag::ImageCut>& vCuts, bool& flag)
+{
+    double res = 0;
+    std::size_t resSize = 0;
+    for (std::size_t i = 0; i + 1 < vCuts.size(); ++i)
+    {
+        for (std::size_t j = i + 1; j < vCuts.size(); ++j)
+        {
+            if (!vCuts[i].outOfBounds() && !vCuts[j].outOfBounds())
+            {
+                const auto& is = vCuts[i].imgSignal();
+                const auto& js = vCuts[j].imgSignal();
+                for (std::size_t k = 0; k < js.size(); ++k)
+                    res += std::pow(is[k] - js[k], 2);
+                ++resSize;
+            }
+        }
+    }
+    flag = resSize != 0;
+    return flag ? float(res / resSize) : std::numeric_limits<float>::max();
+}
+
+/**
+ * @brief Generate cuts holding a noisy step signal, as read across the crowns of a marker.
+ * @param[in] nCuts number of cuts
+ * @param[in] nSamples number of samples per cut
+ * @param[in] noise amplitude of the noise added to the signal
+ * @param[in] seed seed of the random generator
+ */
+std::vector<cctag::ImageCut> makeCuts(std::size_t nCuts, std::size_t nSamples, float noise, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> uniform(-noise, noise);
+
+    std::vector<cctag::ImageCut> vCuts(nCuts);
+    for (auto& cut : vCuts)
+    {
+        cut.imgSignal().resize(nSamples);
+        for (std::size_t k = 0; k < nSamples; ++k)
+            cut.imgSignal()[k] = ((k / 10) % 2 ? 40.f : 210.f) + uniform(gen);
+    }
+    return vCuts;
+}
+
+BOOST_AUTO_TEST_SUITE(test_costFunctionGlob)
+
+BOOST_AUTO_TEST_CASE(test_matches_pairwise)
+{
+    for (const float noise : {0.5f, 5.f, 60.f})
+    {
+        const auto vCuts = makeCuts(22, 100, noise, 42);
+
+        bool expectedFlag = false;
+        bool flag = false;
+        const float expected = pairwiseResidual(vCuts, expectedFlag);
+        const float res = cctag::identification::signalsResidual(vCuts, flag);
+
+        BOOST_CHECK(expectedFlag);
+        BOOST_CHECK(flag);
+        BOOST_CHECK_CLOSE(res, expected, 1e-2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_out_of_bounds)
+{
+    auto vCuts = makeCuts(30, 100, 10.f, 7);
+    for (std::size_t i = 0; i < vCuts.size(); i += 3)
+        vCuts[i].setOutOfBounds(true);
+
+    bool expectedFlag = false;
+    bool flag = false;
+    const float expected = pairwiseResidual(vCuts, expectedFlag);
+    const float res = cctag::identification::signalsResidual(vCuts, flag);
+
+    BOOST_CHECK(flag);
+    BOOST_CHECK_CLOSE(res, expected, 1e-2);
+}
+
+BOOST_AUTO_TEST_CASE(test_no_readable_pair)
+{
+    auto vCuts = makeCuts(5, 100, 10.f, 3);
+    for (std::size_t i = 1; i < vCuts.size(); ++i)
+        vCuts[i].setOutOfBounds(true);
+
+    bool flag = true;
+    const float res = cctag::identification::signalsResidual(vCuts, flag);
+
+    BOOST_CHECK(!flag);
+    BOOST_CHECK_EQUAL(res, std::numeric_limits<float>::max());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,44 @@
+#define BOOST_TEST_MODULE testEdgePointCollection
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/Types.hpp>
+
+#include <stdexcept>
+
+using cctag::EdgePointCollection;
+
+BOOST_AUTO_TEST_SUITE(test_edgePointCollection)
+
+BOOST_AUTO_TEST_CASE(test_reserve_below_max_points)
+{
+    // The headroom of the reservation would exceed MAX_POINTS
+    EdgePointCollection edgeCollection(2, 2);
+    BOOST_CHECK_NO_THROW(edgeCollection.reserve(EdgePointCollection::MAX_POINTS - EdgePointCollection::MAX_POINTS / 8));
+
+    edgeCollection.add_point(1, 1, 3.f, 4.f);
+    BOOST_CHECK_EQUAL(edgeCollection.get_point_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve_max_points)
+{
+    EdgePointCollection edgeCollection(2, 2);
+    BOOST_CHECK_NO_THROW(edgeCollection.reserve(EdgePointCollection::MAX_POINTS));
+
+    edgeCollection.add_point(0, 1, 3.f, 4.f);
+    BOOST_CHECK_EQUAL(edgeCollection.get_point_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(test_reserve_above_max_points)
+{
+    EdgePointCollection edgeCollection(2, 2);
+    BOOST_CHECK_THROW(edgeCollection.reserve(EdgePointCollection::MAX_POINTS + 1), std::length_error);
+
+    // Once at MAX_POINTS, a larger reservation is still rejected
+    BOOST_CHECK_NO_THROW(edgeCollection.reserve(EdgePointCollection::MAX_POINTS));
+    BOOST_CHECK_THROW(edgeCollection.reserve(EdgePointCollection::MAX_POINTS + 1), std::length_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,175 @@
+#define BOOST_TEST_MODULE testGaussianDerivatives
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/filter/derivatives.hpp>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Number of rows of the stripes processed by cannyStripe in cvRecode.cpp
+constexpr int kStripeRows = 32;
+
+/**
+ * @brief Derivatives as computed by cvRecode.cpp when USE_FILTER2D_DERIVATIVES is defined:
+ * the 9x9 kernel and its transpose applied with cv::filter2D and replicated borders.
+ */
+void filter2DDerivatives(const cv::Mat& src, cv::Mat& dx, cv::Mat& dy)
+{
+    const cv::Mat kerneldX = (cv::Mat_<float>(9,9) <<
+    -0.000000143284235f, -0.000003558691641f, -0.000028902492951f, -0.000064765993382f, 0.f, 0.000064765993382f, 0.000028902492951f, 0.000003558691641f, 0.000000143284235f,
+    -0.000004744922188f, -0.000117847682078f, -0.000957119116802f, -0.002144755142391f, 0.f, 0.002144755142391f, 0.000957119116802f, 0.000117847682078f, 0.000004744922188f,
+    -0.000057804985902f, -0.001435678675203f, -0.011660097860113f, -0.026128466569370f, 0.f, 0.026128466569370f, 0.011660097860113f, 0.001435678675203f, 0.000057804985902f,
+    -0.000259063973527f, -0.006434265427174f, -0.052256933138740f, -0.117099663048638f, 0.f, 0.117099663048638f, 0.052256933138740f, 0.006434265427174f, 0.000259063973527f,
+    -0.000427124283626f, -0.010608310271112f, -0.086157117207395f, -0.193064705260108f, 0.f, 0.193064705260108f, 0.086157117207395f, 0.010608310271112f, 0.000427124283626f,
+    -0.000259063973527f, -0.006434265427174f, -0.052256933138740f, -0.117099663048638f, 0.f, 0.117099663048638f, 0.052256933138740f, 0.006434265427174f, 0.000259063973527f,
+    -0.000057804985902f, -0.001435678675203f, -0.011660097860113f, -0.026128466569370f, 0.f, 0.026128466569370f, 0.011660097860113f, 0.001435678675203f, 0.000057804985902f,
+    -0.000004744922188f, -0.000117847682078f, -0.000957119116802f, -0.002144755142391f, 0.f, 0.002144755142391f, 0.000957119116802f, 0.000117847682078f, 0.000004744922188f,
+    -0.000000143284235f, -0.000003558691641f, -0.000028902492951f, -0.000064765993382f, 0.f, 0.000064765993382f, 0.000028902492951f, 0.000003558691641f, 0.000000143284235f);
+
+    const cv::Mat kerneldY = kerneldX.t();
+
+    const cv::Point anchor{-1, -1};
+    const double delta{0};
+
+    cv::filter2D(src, dx, CV_16SC1, kerneldX, anchor, delta, cv::BORDER_REPLICATE);
+    cv::filter2D(src, dy, CV_16SC1, kerneldY, anchor, delta, cv::BORDER_REPLICATE);
+}
+
+/**
+ * @brief Generate a random gray image whose outermost rows and columns are saturated, so
+ * that the replicated borders carry strong edges.
+ * @param[in] rows number of rows
+ * @param[in] cols number of columns
+ * @param[in] seed seed of the random generator
+ */
+cv::Mat makeImage(int rows, int cols, unsigned seed)
+{
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> uniform(0, 255);
+
+    cv::Mat img(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; ++y)
+    {
+        uchar* row = img.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x)
+        {
+            if (y == 0 || x == 0)
+                row[x] = 255;
+            else if (y == rows - 1 || x == cols - 1)
+                row[x] = 0;
+            else
+                row[x] = uchar(uniform(gen));
+        }
+    }
+    return img;
+}
+
+/**
+ * @brief Maximum absolute difference between the rows [0, nRows) of a, starting at row aBegin,
+ * and those of b, starting at row bBegin.
+ */
+int maxAbsDiff(const cv::Mat& a, int aBegin, const cv::Mat& b, int bBegin, int nRows)
+{
+    int res = 0;
+    for (int y = 0; y < nRows; ++y)
+    {
+        const short* aRow = a.ptr<short>(aBegin + y);
+        const short* bRow = b.ptr<short>(bBegin + y);
+        for (int x = 0; x < a.cols; ++x)
+            res = std::max(res, std::abs(aRow[x] - bRow[x]));
+    }
+    return res;
+}
+
+// Sizes (rows, cols) smaller than the kernel, and row counts that are not a multiple of the stripe
+const std::vector<std::pair<int, int>> kSizes = {
+    {1, 1}, {1, 9}, {9, 1}, {3, 5}, {8, 7}, {2, 40},
+    {33, 17}, {45, 63}, {70, 101}, {97, 9}, {kStripeRows + 1, 4}};
+
+BOOST_AUTO_TEST_SUITE(test_gaussianDerivatives)
+
+BOOST_AUTO_TEST_CASE(test_matches_filter2D)
+{
+    unsigned seed = 0;
+    for (const auto& size : kSizes)
+    {
+        const cv::Mat img = makeImage(size.first, size.second, ++seed);
+
+        cv::Mat refDX, refDY;
+        filter2DDerivatives(img, refDX, refDY);
+
+        cv::Mat dx, dy;
+        cctag::gaussianDerivatives(img, dx, dy);
+
+        BOOST_REQUIRE_EQUAL(dx.rows, img.rows);
+        BOOST_REQUIRE_EQUAL(dx.cols, img.cols);
+        BOOST_REQUIRE_EQUAL(dy.rows, img.rows);
+        BOOST_REQUIRE_EQUAL(dy.cols, img.cols);
+        BOOST_CHECK_LE(maxAbsDiff(dx, 0, refDX, 0, img.rows), 1);
+        BOOST_CHECK_LE(maxAbsDiff(dy, 0, refDY, 0, img.rows), 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_row_range)
+{
+    unsigned seed = 200;
+    for (const auto& size : kSizes)
+    {
+        const cv::Mat img = makeImage(size.first, size.second, ++seed);
+
+        cv::Mat dx, dy;
+        cctag::gaussianDerivatives(img, dx, dy);
+
+        cv::Mat rangeDX(img.rows, img.cols, CV_16SC1);
+        cv::Mat rangeDY(img.rows, img.cols, CV_16SC1);
+        for (int rowBegin = 0; rowBegin < img.rows; rowBegin += 3)
+        {
+            const int rowEnd = std::min(rowBegin + 3, img.rows);
+            cctag::gaussianDerivatives(img, rangeDX, rangeDY, rowBegin, rowEnd);
+        }
+
+        BOOST_CHECK_EQUAL(maxAbsDiff(rangeDX, 0, dx, 0, img.rows), 0);
+        BOOST_CHECK_EQUAL(maxAbsDiff(rangeDY, 0, dy, 0, img.rows), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(test_stripe_band)
+{
+    unsigned seed = 300;
+    for (const auto& size : kSizes)
+    {
+        const cv::Mat img = makeImage(size.first, size.second, ++seed);
+
+        cv::Mat dx, dy;
+        cctag::gaussianDerivatives(img, dx, dy);
+
+        // Band buffers filled as in cannyStripe: the stripe and its neighbour rows, from row 0
+        cv::Mat bandDX(kStripeRows + 2, img.cols, CV_16SC1);
+        cv::Mat bandDY(kStripeRows + 2, img.cols, CV_16SC1);
+        for (int rowBegin = 0; rowBegin < img.rows; rowBegin += kStripeRows)
+        {
+            const int rowEnd = std::min(rowBegin + kStripeRows, img.rows);
+            const int bandBegin = std::max(rowBegin - 1, 0);
+            const int bandEnd = std::min(rowEnd + 1, img.rows);
+
+            cctag::gaussianDerivatives(img, bandDX, bandDY, bandBegin, bandEnd, 0);
+
+            for (int y = bandBegin; y < bandEnd; ++y)
+            {
+                BOOST_CHECK_EQUAL(maxAbsDiff(bandDX, y - bandBegin, dx, y, 1), 0);
+                BOOST_CHECK_EQUAL(maxAbsDiff(bandDY, y - bandBegin, dy, y, 1), 0);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
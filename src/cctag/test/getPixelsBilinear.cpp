@@ -0,0 +1,148 @@
+#define BOOST_TEST_MODULE testGetPixelsBilinear
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/Identification.hpp>
+
+#include <opencv2/core.hpp>
+
+#include <random>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @brief Random gray image whose last pixel is followed by an unreadable page, so that any
+ * read past the end of the image buffer crashes the test.
+ */
+class GuardedImage
+{
+public:
+    GuardedImage(int rows, int cols, unsigned seed)
+    {
+        const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+        const std::size_t size = std::size_t(rows) * cols;
+        _length = (size + pageSize - 1) / pageSize * pageSize + pageSize;
+        void* mapping = mmap(nullptr, _length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        BOOST_REQUIRE(mapping != MAP_FAILED);
+        _mapping = static_cast<uchar*>(mapping);
+        BOOST_REQUIRE(mprotect(_mapping + _length - pageSize, pageSize, PROT_NONE) == 0);
+
+        _img = cv::Mat(rows, cols, CV_8UC1, _mapping + _length - pageSize - size, cols);
+
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<int> uniform(0, 255);
+        for (int y = 0; y < rows; ++y)
+            for (int x = 0; x < cols; ++x)
+                _img.at<uchar>(y, x) = uchar(uniform(gen));
+    }
+
+    ~GuardedImage()
+    {
+        munmap(_mapping, _length);
+    }
+
+    GuardedImage(const GuardedImage&) = delete;
+
+    GuardedImage& operator=(const GuardedImage&) = delete;
+
+    const cv::Mat& image() const { return _img; }
+
+private:
+    uchar* _mapping = nullptr;
+    std::size_t _length = 0;
+    cv::Mat _img;
+};
+
+/**
+ * @brief Check that getPixelsBilinear returns exactly the values of getPixelBilinear.
+ */
+void checkMatchesScalar(const cv::Mat& src, const std::vector<float>& xs, const std::vector<float>& ys)
+{
+    std::vector<float> values(xs.size());
+    cctag::identification::getPixelsBilinear(src, xs.data(), ys.data(), xs.size(), values.data());
+
+    for (std::size_t i = 0; i < xs.size(); ++i)
+        BOOST_CHECK_EQUAL(values[i], cctag::identification::getPixelBilinear(src, xs[i], ys[i]));
+}
+
+// The bottom-right corner of a larger image: not continuous, and its last pixel is the last
+// readable byte.
+const int kParentRows = 48;
+const int kParentCols = 64;
+const int kRows = 21;
+const int kCols = 29;
+
+BOOST_AUTO_TEST_SUITE(test_getPixelsBilinear)
+
+BOOST_AUTO_TEST_CASE(test_roi_interior)
+{
+    const GuardedImage parent(kParentRows, kParentCols, 1);
+    const cv::Mat src = parent.image()(cv::Rect(kParentCols - kCols, kParentRows - kRows, kCols, kRows));
+    BOOST_REQUIRE(!src.isContinuous());
+
+    std::mt19937 gen(2);
+    std::uniform_real_distribution<float> uniformX(0.f, kCols - 1.f);
+    std::uniform_real_distribution<float> uniformY(0.f, kRows - 1.f);
+
+    // Not a multiple of the 8 lanes
+    const std::size_t n = 8 * 25 + 5;
+    std::vector<float> xs(n), ys(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        xs[i] = uniformX(gen);
+        ys[i] = uniformY(gen);
+    }
+    checkMatchesScalar(src, xs, ys);
+}
+
+BOOST_AUTO_TEST_CASE(test_roi_last_row_and_columns)
+{
+    const GuardedImage parent(kParentRows, kParentCols, 3);
+    const cv::Mat src = parent.image()(cv::Rect(kParentCols - kCols, kParentRows - kRows, kCols, kRows));
+    BOOST_REQUIRE(!src.isContinuous());
+
+    std::mt19937 gen(4);
+    std::uniform_real_distribution<float> uniformX(0.f, kCols - 1.f);
+    std::uniform_real_distribution<float> uniformY(0.f, kRows - 1.f);
+    std::uniform_real_distribution<float> lastColumns(kCols - 5.f, kCols - 1.f);
+    std::uniform_real_distribution<float> lastRow(kRows - 2.f, kRows - 1.f);
+
+    // Samples in the last row and in the last 4 columns, alone or mixed with interior samples
+    // within a batch of 8, and a count that is not a multiple of 8.
+    const std::size_t n = 8 * 40 + 3;
+    std::vector<float> xs(n), ys(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        switch ((i / 8) % 4)
+        {
+            case 0:
+                xs[i] = lastColumns(gen);
+                ys[i] = lastRow(gen);
+                break;
+            case 1:
+                xs[i] = uniformX(gen);
+                ys[i] = lastRow(gen);
+                break;
+            case 2:
+                xs[i] = lastColumns(gen);
+                ys[i] = uniformY(gen);
+                break;
+            default:
+                xs[i] = (i % 8 == 7) ? lastColumns(gen) : uniformX(gen);
+                ys[i] = (i % 8 == 7) ? lastRow(gen) : uniformY(gen);
+                break;
+        }
+    }
+
+    // The extreme sample locations
+    xs.insert(xs.end(), {kCols - 1.001f, 0.f, kCols - 1.001f, 0.f});
+    ys.insert(ys.end(), {kRows - 1.001f, kRows - 1.001f, 0.f, 0.f});
+
+    checkMatchesScalar(src, xs, ys);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,179 @@
+#define BOOST_TEST_MODULE testImagedCenterOptimization
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/Identification.hpp>
+#include <cctag/Params.hpp>
+#include <cctag/geometry/Circle.hpp>
+#include <cctag/geometry/Ellipse.hpp>
+
+#include <boost/math/constants/constants.hpp>
+#include <opencv2/core.hpp>
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Number of synthetic markers of the benchmark
+constexpr int kNumMarkers = 40;
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+
+/**
+ * @brief Render a marker of the bank seen through a homography from the cctag plane (outer
+ * circle of radius 1) to the image, with 2x2 supersampling.
+ * @param[in] radiusRatios radius ratios of the marker, as stored in the bank
+ * @param[in] mHomography cctag plane to image homography
+ * @param[out] img rendered gray image
+ */
+void renderMarker(const std::vector<float>& radiusRatios, const Eigen::Matrix3f& mHomography, cv::Mat& img)
+{
+    const Eigen::Matrix3f mInvHomography = mHomography.inverse();
+    img.create(kHeight, kWidth, CV_8UC1);
+    for (int y = 0; y < kHeight; ++y)
+    {
+        for (int x = 0; x < kWidth; ++x)
+        {
+            float acc = 0.f;
+            for (int sy = 0; sy < 2; ++sy)
+            {
+                for (int sx = 0; sx < 2; ++sx)
+                {
+                    const Eigen::Vector3f p = mInvHomography * Eigen::Vector3f(x - 0.25f + 0.5f * sx, y - 0.25f + 0.5f * sy, 1.f);
+                    const float r = std::hypot(p(0) / p(2), p(1) / p(2));
+                    int nCircles = 0;
+                    for (const float ratio : radiusRatios)
+                        nCircles += (1.f / ratio <= r);
+                    float value = (r > 1.f || nCircles % 2 == 0) ? 230.f : 20.f;
+                    if (r > 1.3f)
+                        value = 128.f;
+                    acc += value;
+                }
+            }
+            img.at<uchar>(y, x) = uchar(acc / 4);
+        }
+    }
+}
+
+struct ModeStatistics
+{
+    double sumError = 0;
+    std::size_t nEvaluations = 0;
+    double milliseconds = 0;
+    int nConverged = 0;
+};
+
+/**
+ * @brief Optimize the imaged center of a rendered marker and accumulate the error to its
+ * true imaged center, the number of cost function evaluations and the duration.
+ */
+void optimizeCenter(const cv::Mat& img,
+                    const cctag::numerical::geometry::Ellipse& outerEllipse,
+                    const std::vector<cctag::ImageCut>& vSelectedCuts,
+                    const Eigen::Vector3f& trueCenter,
+                    const cctag::Parameters& params,
+                    ModeStatistics& stats)
+{
+    std::vector<cctag::ImageCut> vCuts = vSelectedCuts;
+    Eigen::Matrix3f mHomography;
+    cctag::Point2d<Eigen::Vector3f> center = outerEllipse.center();
+    float residual = 0;
+
+    const std::size_t nEvaluations = cctag::identification::costFunctionGlobEvaluations();
+    const auto start = std::chrono::steady_clock::now();
+    const bool converged = cctag::identification::refineConicFamilyGlob(
+            0, mHomography, center, vCuts, img, nullptr, outerEllipse, params, nullptr, residual);
+    const auto stop = std::chrono::steady_clock::now();
+
+    stats.nEvaluations += cctag::identification::costFunctionGlobEvaluations() - nEvaluations;
+    stats.milliseconds += std::chrono::duration<double, std::milli>(stop - start).count();
+    if (converged)
+    {
+        stats.sumError += std::hypot(center.x() - trueCenter(0), center.y() - trueCenter(1));
+        ++stats.nConverged;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(test_imagedCenterOptimization)
+
+/**
+ * @brief Compare the successively refined grids with the simplex on synthetic markers whose
+ * imaged center is known, for accuracy and cost function evaluations per marker.
+ */
+BOOST_AUTO_TEST_CASE(test_grid_vs_simplex)
+{
+    const std::size_t nCrowns = 4;
+    const cctag::CCTagMarkersBank bank(nCrowns);
+    const std::vector<float>& radiusRatios = bank.getMarkers()[7];
+
+    cctag::Parameters gridParams(nCrowns);
+    gridParams._imagedCenterSimplex = false;
+    cctag::Parameters simplexParams(nCrowns);
+    simplexParams._imagedCenterSimplex = true;
+
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+
+    ModeStatistics grid, simplex;
+    cv::Mat img;
+    for (int iMarker = 0; iMarker < kNumMarkers; ++iMarker)
+    {
+        // Outer circle of 60 to 140 pixels with some perspective
+        const float radius = 100.f + 40.f * uniform(gen);
+        Eigen::Matrix3f mHomography;
+        mHomography << radius * (1.f + 0.2f * uniform(gen)), radius * 0.2f * uniform(gen), 320.f + 40.f * uniform(gen),
+                       radius * 0.2f * uniform(gen), radius * (1.f + 0.2f * uniform(gen)), 240.f + 30.f * uniform(gen),
+                       0.1f * uniform(gen), 0.1f * uniform(gen), 1.f;
+        renderMarker(radiusRatios, mHomography, img);
+
+        const Eigen::Matrix3f mInvHomography = mHomography.inverse();
+        const cctag::numerical::geometry::Circle circle(1.f);
+        const cctag::numerical::geometry::Ellipse outerEllipse(Eigen::Matrix3f(mInvHomography.transpose() * circle.matrix() * mInvHomography));
+
+        std::vector<cctag::DirectedPoint2d<Eigen::Vector3f>> outerPoints;
+        for (int k = 0; k < 150; ++k)
+        {
+            const float angle = 2.f * boost::math::constants::pi<float>() * k / 150;
+            const Eigen::Vector3f p = mHomography * Eigen::Vector3f(std::cos(angle), std::sin(angle), 1.f);
+            outerPoints.emplace_back(p(0) / p(2), p(1) / p(2), 0.f, 0.f);
+        }
+
+        Eigen::Vector3f trueCenter = mHomography * Eigen::Vector3f(0.f, 0.f, 1.f);
+        trueCenter /= trueCenter(2);
+
+        std::vector<cctag::ImageCut> cuts;
+        cctag::identification::collectCuts(cuts, img, outerEllipse.center(), outerPoints, gridParams._sampleCutLength, 0.26f);
+
+        // About _numCutsInIdentStep cuts, uniformly spread
+        std::vector<cctag::ImageCut> vSelectedCuts;
+        for (std::size_t k = 0; k < cuts.size(); k += 7)
+            vSelectedCuts.push_back(cuts[k]);
+
+        optimizeCenter(img, outerEllipse, vSelectedCuts, trueCenter, gridParams, grid);
+        optimizeCenter(img, outerEllipse, vSelectedCuts, trueCenter, simplexParams, simplex);
+    }
+
+    for (const auto& mode : {std::make_pair("grid", &grid), std::make_pair("simplex", &simplex)})
+    {
+        const ModeStatistics& stats = *mode.second;
+        BOOST_TEST_MESSAGE(mode.first << ": converged " << stats.nConverged << "/" << kNumMarkers
+                           << ", mean error " << stats.sumError / std::max(stats.nConverged, 1) << " px"
+                           << ", " << double(stats.nEvaluations) / kNumMarkers << " evaluations/marker"
+                           << ", " << stats.milliseconds / kNumMarkers << " ms/marker");
+    }
+
+    BOOST_CHECK_EQUAL(grid.nConverged, kNumMarkers);
+    BOOST_CHECK_EQUAL(simplex.nConverged, kNumMarkers);
+    BOOST_CHECK_LT(grid.sumError / kNumMarkers, 0.05);
+    BOOST_CHECK_LT(simplex.sumError / kNumMarkers, 0.05);
+    BOOST_CHECK_LT(simplex.nEvaluations, grid.nEvaluations);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
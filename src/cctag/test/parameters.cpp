@@ -0,0 +1,107 @@
+#define BOOST_TEST_MODULE testParameters
+
+#define BOOST_TEST_DYN_LINK
+
+#include <boost/test/unit_test.hpp>
+
+#include <cctag/Params.hpp>
+
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/archive/xml_oarchive.hpp>
+
+#include <sstream>
+#include <string>
+
+// Parameters file saved before the class version was introduced (version 0)
+const std::string kParametersV0 = R"(<?xml version="1.0" encoding="UTF-8" standalone="yes" ?>
+<!DOCTYPE boost_serialization>
+<boost_serialization signature="serialization::archive" version="12">
+<CCTagsParams class_id="0" tracking_level="0" version="0">
+<_cannyThrLow>9.999999776e-03</_cannyThrLow>
+<_cannyThrHigh>3.999999911e-02</_cannyThrHigh>
+<_distSearch>30</_distSearch>
+<_thrGradientMagInVote>2500</_thrGradientMagInVote>
+<_angleVoting>0.000000000e+00</_angleVoting>
+<_ratioVoting>4.000000000e+00</_ratioVoting>
+<_averageVoteMin>0.000000000e+00</_averageVoteMin>
+<_thrMedianDistanceEllipse>3.000000000e+00</_thrMedianDistanceEllipse>
+<_maximumNbSeeds>500</_maximumNbSeeds>
+<_maximumNbCandidatesLoopTwo>40</_maximumNbCandidatesLoopTwo>
+<_nCrowns>3</_nCrowns>
+<_minPointsSegmentCandidate>10</_minPointsSegmentCandidate>
+<_minVotesToSelectCandidate>3</_minVotesToSelectCandidate>
+<_threshRobustEstimationOfOuterEllipse>3.000000000e+01</_threshRobustEstimationOfOuterEllipse>
+<_ellipseGrowingEllipticHullWidth>2.299999952e+00</_ellipseGrowingEllipticHullWidth>
+<_windowSizeOnInnerEllipticSegment>20</_windowSizeOnInnerEllipticSegment>
+<_numberOfMultiresLayers>4</_numberOfMultiresLayers>
+<_numberOfProcessedMultiresLayers>4</_numberOfProcessedMultiresLayers>
+<_nSamplesOuterEllipse>150</_nSamplesOuterEllipse>
+<_numCutsInIdentStep>22</_numCutsInIdentStep>
+<_numSamplesOuterEdgePointsRefinement>20</_numSamplesOuterEdgePointsRefinement>
+<_cutsSelectionTrials>500</_cutsSelectionTrials>
+<_sampleCutLength>100</_sampleCutLength>
+<_imagedCenterNGridSample>5</_imagedCenterNGridSample>
+<_imagedCenterNeighbourSize>2.000000030e-01</_imagedCenterNeighbourSize>
+<_minIdentProba>9.999999975e-07</_minIdentProba>
+<_useLMDif>1</_useLMDif>
+<_searchForAnotherSegment>1</_searchForAnotherSegment>
+<_writeOutput>0</_writeOutput>
+<_doIdentification>1</_doIdentification>
+<_maxEdges>12345</_maxEdges>
+<_useCuda>0</_useCuda>
+<_pinnedCounters>100</_pinnedCounters>
+<_pinnedNearbyPoints>60</_pinnedNearbyPoints>
+</CCTagsParams>
+</CCTagsParams>
+</boost_serialization>
+)";
+
+/**
+ * @brief Load parameters from an xml archive, as Parameters::LoadOverride does.
+ * @param[in] xml content of the archive
+ */
+cctag::Parameters loadParameters(const std::string& xml)
+{
+    cctag::Parameters params;
+    std::istringstream iss(xml);
+    boost::archive::xml_iarchive ia(iss);
+    ia >> boost::serialization::make_nvp("CCTagsParams", params);
+    return params;
+}
+
+BOOST_AUTO_TEST_SUITE(test_parameters)
+
+BOOST_AUTO_TEST_CASE(test_load_version_0)
+{
+    const cctag::Parameters params = loadParameters(kParametersV0);
+
+    BOOST_CHECK_EQUAL(params._maxEdges, 12345);
+    BOOST_CHECK_EQUAL(params._pinnedNearbyPoints, 60);
+    BOOST_CHECK_EQUAL(params._parallelHysteresis, cctag::kDefaultParallelHysteresis);
+    BOOST_CHECK_EQUAL(params._imagedCenterSimplex, cctag::kDefaultImagedCenterSimplex);
+    BOOST_CHECK_EQUAL(params._imagedCenterMaxIterations, cctag::kDefaultImagedCenterMaxIterations);
+}
+
+BOOST_AUTO_TEST_CASE(test_save_load)
+{
+    cctag::Parameters saved;
+    saved._maxEdges = 54321;
+    saved._parallelHysteresis = !cctag::kDefaultParallelHysteresis;
+    saved._imagedCenterSimplex = !cctag::kDefaultImagedCenterSimplex;
+    saved._imagedCenterMaxIterations = 2 * cctag::kDefaultImagedCenterMaxIterations;
+
+    std::ostringstream oss;
+    {
+        boost::archive::xml_oarchive oa(oss);
+        oa << boost::serialization::make_nvp("CCTagsParams", saved);
+    }
+
+    const cctag::Parameters params = loadParameters(oss.str());
+
+    BOOST_CHECK_EQUAL(params._maxEdges, saved._maxEdges);
+    BOOST_CHECK_EQUAL(params._parallelHysteresis, saved._parallelHysteresis);
+    BOOST_CHECK_EQUAL(params._imagedCenterSimplex, saved._imagedCenterSimplex);
+    BOOST_CHECK_EQUAL(params._imagedCenterMaxIterations, saved._imagedCenterMaxIterations);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -33,6 +33,14 @@
 #define RAISED_EXCEPTION 12
 #define PASS_ALLTESTS 30
 
+// The vote output is only produced by serial builds; otherwise keep the singleton lookups
+// out of the field line descent.
+#if defined(CCTAG_SERIALIZE) && defined(CCTAG_VOTE_DEBUG)
+#define CCTAG_VOTE_DEBUG_CALL(call) CCTagFileDebug::instance().call
+#else
+#define CCTAG_VOTE_DEBUG_CALL(call)
+#endif
+
 namespace cctag {
 
         class CCTagFileDebug : public Singleton<CCTagFileDebug> {